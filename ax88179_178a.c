@@ -39,6 +39,13 @@
 #include <linux/usb.h>
 #include <linux/crc32.h>
 #include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/jhash.h>
+#include <net/dsfield.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include <net/tcp.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 25)
 #include <linux/usb/usbnet.h>
@@ -48,7 +55,35 @@
 
 #include "ax88179_178a.h"
 
-static char version[] =
+#ifdef AX_NAPI_RX
+#include <linux/scatterlist.h>
+#endif
+
+#ifdef AX_RX_DIM
+#include <linux/dim.h>
+#endif
+
+#ifdef AX_XDP
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
+#include <net/xdp.h>
+#endif
+
+#ifdef AX_XSK
+#include <net/xdp_sock_drv.h>
+#endif
+
+#ifdef AX_RX_PAGE_POOL
+#include <linux/usb/hcd.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+#include <net/page_pool/helpers.h>
+#else
+#include <net/page_pool.h>
+#endif
+#endif
+
+static const char version[] =
 KERN_INFO "ASIX USB Ethernet Adapter:v" DRIVER_VERSION
 //	" " __TIME__ " " __DATE__ "\n"
 "		http://www.asix.com.tw\n";
@@ -65,6 +100,18 @@ static int ifg = -1;
 module_param(ifg, int, 0);
 MODULE_PARM_DESC(ifg, "RX Bulk IN Inter Frame Gap");
 
+static int reg_check;
+module_param(reg_check, int, 0644);
+MODULE_PARM_DESC(reg_check, "Verify the register shadow against the device");
+
+static int rx_copybreak = -1;
+module_param(rx_copybreak, int, 0);
+MODULE_PARM_DESC(rx_copybreak, "Copy RX frames up to this size");
+
+static int fast_start = 1;
+module_param(fast_start, int, 0644);
+MODULE_PARM_DESC(fast_start, "Skip the PHY setup bind has just done on the first open");
+
 
 /* EEE advertisement is disabled in default setting */
 static int bEEE = 0;
@@ -77,13 +124,174 @@ module_param(bGETH, int, 0);
 MODULE_PARM_DESC(bGETH, "Green ethernet configuration");
 /* ASIX AX88179/178A based USB 3.0/2.0 Gigabit Ethernet Devices */
 
+static inline struct ax88179_priv *ax88179_get_priv(struct usbnet *dev)
+{
+	return ((struct ax88179_data *)dev->data)->priv;
+}
+
+/* Bring-up step timing, logged with NETIF_MSG_HW in msg_enable
+ * ("ethtool -s ethX msglvl hw on", or the msg_enable parameter for probe).
+ */
+static void ax88179_step_time(struct usbnet *dev, const char *step, ktime_t *t)
+{
+	ktime_t now = ktime_get();
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+	netif_info(dev, hw, dev->net, "%s: %lld us\n", step,
+		   (long long)ktime_us_delta(now, *t));
+#endif
+	*t = now;
+}
+
+/* Shadow bytes covered by a MAC register access, 0 if it is not cached */
+static u64 ax88179_reg_bits(struct ax88179_priv *priv, u8 cmd, u16 reg,
+			    u16 size)
+{
+	u64 bits;
+
+	if (!priv || cmd != AX_ACCESS_MAC || !size ||
+	    reg + size > AX_REG_SHADOW_SIZE)
+		return 0;
+
+	bits = AX_REG_BITS(reg, size);
+	return (bits & AX_REG_SHADOW_MASK) == bits ? bits : 0;
+}
+
+/* Copy out the shadow of a register, false if it is not known */
+static bool ax88179_reg_get(struct ax88179_priv *priv, u64 bits, u16 reg,
+			    void *data, u16 size)
+{
+	unsigned long flags;
+	bool hit;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	hit = (priv->reg_valid & bits) == bits;
+	if (hit)
+		memcpy(data, &priv->reg_shadow[reg], size);
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	return hit;
+}
+
+/* Whether writing data would leave the register as it is */
+static bool ax88179_reg_same(struct ax88179_priv *priv, u64 bits, u16 reg,
+			     const void *data, u16 size)
+{
+	unsigned long flags;
+	bool same;
+
+	/* Writes to PHYPWR_RSTCTL reset the PHY, never skip them */
+	if (reg == AX_PHYPWR_RSTCTL)
+		return false;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	same = (priv->reg_valid & bits) == bits &&
+	       !memcmp(&priv->reg_shadow[reg], data, size);
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	return same;
+}
+
+/* Record what the device holds after a transfer, NULL when unknown */
+static void ax88179_reg_set(struct ax88179_priv *priv, u64 bits, u16 reg,
+			    const void *data, u16 size)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	/* Anything may change across a PHY power or reset cycle */
+	if (reg == AX_PHYPWR_RSTCTL)
+		priv->reg_valid = 0;
+
+	if (data) {
+		memcpy(&priv->reg_shadow[reg], data, size);
+		priv->reg_valid |= bits;
+	} else {
+		priv->reg_valid &= ~bits;
+	}
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+}
+
+/* reg_check: compare a read from the device with the shadow */
+static void ax88179_reg_verify(struct usbnet *dev, u64 bits, u16 reg,
+			       const void *data, u16 size)
+{
+	u8 shadow[8];
+
+	if (ax88179_reg_get(ax88179_get_priv(dev), bits, reg, shadow, size) &&
+	    memcmp(shadow, data, size))
+		netdev_warn(dev->net,
+			    "reg 0x%02x: shadow %*ph, device %*ph\n",
+			    reg, size, shadow, size, data);
+}
+
+/* Vendor request through the device's DMA-safe io_buf, so callers can
+ * pass any buffer and usbnet needs no bounce buffer per access.
+ */
+static int ax88179_io(struct usbnet *dev, u8 dir, u8 cmd, u16 value,
+		      u16 index, void *data, u16 size, int in_pm)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	unsigned int pipe;
+	int ret;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
+	if (!in_pm) {
+		ret = usb_autopm_get_interface(dev->intf);
+		if (ret < 0)
+			return ret;
+	}
+#endif
+
+	mutex_lock(&priv->io_lock);
+	if (dir == USB_DIR_IN) {
+		pipe = usb_rcvctrlpipe(dev->udev, 0);
+	} else {
+		pipe = usb_sndctrlpipe(dev->udev, 0);
+		memcpy(priv->io_buf, data, size);
+	}
+
+	ret = usb_control_msg(dev->udev, pipe, cmd,
+			      dir | USB_TYPE_VENDOR | USB_RECIP_DEVICE,
+			      value, index, size ? priv->io_buf : NULL, size,
+			      dir == USB_DIR_IN ? USB_CTRL_GET_TIMEOUT :
+						  USB_CTRL_SET_TIMEOUT);
+
+	if (dir == USB_DIR_IN && ret > 0)
+		memcpy(data, priv->io_buf, min_t(int, ret, size));
+	mutex_unlock(&priv->io_lock);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
+	if (!in_pm)
+		usb_autopm_put_interface(dev->intf);
+#endif
+	return ret;
+}
+
 static int __ax88179_read_cmd(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 			      u16 size, void *data, int in_pm)
 {
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	u64 bits = ax88179_reg_bits(priv, cmd, value, size);
 	int ret;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
 	int (*fn)(struct usbnet *, u8, u8, u16, u16, void *, u16);
+#endif
+
+	if (bits && !reg_check && ax88179_reg_get(priv, bits, value, data, size))
+		return size;
 
+	if (priv && size <= AX_IO_BUF_LEN) {
+		ret = ax88179_io(dev, USB_DIR_IN, cmd, value, index, data,
+				 size, in_pm);
+		if (unlikely(ret < 0))
+			netdev_warn(dev->net,
+				    "Failed to read reg index 0x%04x: %d\n",
+				    index, ret);
+		goto out;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
 	BUG_ON(!dev);
 
 	if (!in_pm)
@@ -109,16 +317,42 @@ static int __ax88179_read_cmd(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 		size,
 		USB_CTRL_GET_TIMEOUT);
 #endif
+out:
+	if (bits && ret == size) {
+		if (reg_check)
+			ax88179_reg_verify(dev, bits, value, data, size);
+		ax88179_reg_set(priv, bits, value, data, size);
+	}
+
 	return ret;
 }
 
 static int __ax88179_write_cmd(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 			       u16 size, void *data, int in_pm)
 {
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	u64 bits = ax88179_reg_bits(priv, cmd, value, size);
 	int ret;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
 	int (*fn)(struct usbnet *, u8, u8, u16, u16, const void *, u16);
+#endif
 
+	/* Skip writes that would not change the register */
+	if (bits && !reg_check &&
+	    ax88179_reg_same(priv, bits, value, data, size))
+		return size;
+
+	if (priv && size <= AX_IO_BUF_LEN) {
+		ret = ax88179_io(dev, USB_DIR_OUT, cmd, value, index, data,
+				 size, in_pm);
+		if (unlikely(ret < 0))
+			netdev_warn(dev->net,
+				    "Failed to write reg index 0x%04x: %d\n",
+				    index, ret);
+		goto out;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 8, 0)
 	BUG_ON(!dev);
 
 	if (!in_pm)
@@ -145,6 +379,13 @@ static int __ax88179_write_cmd(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 		USB_CTRL_SET_TIMEOUT);
 
 #endif
+out:
+	if (bits)
+		ax88179_reg_set(priv, bits, value, ret == size ? data : NULL,
+				size);
+	if (cmd == AX_ACCESS_MAC)
+		ax88179_async_forget(priv, value);
+
 	return ret;
 }
 
@@ -231,91 +472,153 @@ static int ax88179_write_cmd(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 	return ret;
 }
 
+/* Submit the slot's data, called with async_lock held */
+static int ax88179_async_submit(struct ax88179_async_handle *slot)
+{
+	int ret;
+
+	ret = usb_submit_urb(slot->urb, GFP_ATOMIC);
+	slot->busy = !ret;
+	slot->known = 0;
+
+	return ret;
+}
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 20)
 static void ax88179_async_cmd_callback(struct urb *urb, struct pt_regs *regs)
 #else
 static void ax88179_async_cmd_callback(struct urb *urb)
 #endif
 {
-	struct ax88179_async_handle *asyncdata = (struct ax88179_async_handle *)urb->context;
+	struct ax88179_async_handle *slot = urb->context;
+	struct ax88179_priv *priv = slot->priv;
+	unsigned long flags;
+	int ret = 0;
 
 	if (urb->status < 0)
 		printk(KERN_ERR "ax88179_async_cmd_callback() failed with %d",
 		       urb->status);
 
-	kfree(asyncdata->req);
-	kfree(asyncdata);	
-	usb_free_urb(urb);
-	
+	spin_lock_irqsave(&priv->async_lock, flags);
+	slot->busy = 0;
+	slot->known = !urb->status;
+
+	/* Send the latest value that came in meanwhile */
+	if (slot->dirty) {
+		slot->dirty = 0;
+		if (!slot->known || memcmp(slot->data, slot->next, slot->size)) {
+			memcpy(slot->data, slot->next, slot->size);
+			ret = ax88179_async_submit(slot);
+		}
+	}
+	spin_unlock_irqrestore(&priv->async_lock, flags);
+
+	if (ret < 0)
+		printk(KERN_ERR "ax88179_async_cmd_callback() resubmit failed with %d",
+		       ret);
 }
 
-static void
-ax88179_write_cmd_async(struct usbnet *dev, u8 cmd, u16 value, u16 index,
-				    u16 size, void *data)
+/* Slot for a register, bound on first use, NULL when all are taken */
+static struct ax88179_async_handle *
+ax88179_async_slot(struct ax88179_priv *priv, u8 cmd, u16 value, u16 index,
+		   u16 size)
 {
-	struct usb_ctrlrequest *req = NULL;
-	int status = 0;
-	struct urb *urb = NULL;
-	void *buf = NULL;
-	struct ax88179_async_handle *asyncdata = NULL;
+	struct ax88179_async_handle *slot;
+	int i;
 
-	urb = usb_alloc_urb(0, GFP_ATOMIC);
-	if (urb == NULL) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_err(dev->net, "Error allocating URB in write_cmd_async!");
-#else
-		deverr(dev, "Error allocating URB in write_cmd_async!");
-#endif
-		return;
+	for (i = 0; i < AX_ASYNC_SLOTS; i++) {
+		slot = &priv->async[i];
+		if (!slot->used)
+			break;
+		if (slot->req.bRequest == cmd &&
+		    slot->req.wValue == cpu_to_le16(value) &&
+		    slot->req.wIndex == cpu_to_le16(index) &&
+		    slot->size == size)
+			return slot;
 	}
 
-	req = kmalloc(sizeof(struct usb_ctrlrequest), GFP_ATOMIC);
-	if (req == NULL) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_err(dev->net, "Failed to allocate memory for control request");
-#else
-		deverr(dev, "Failed to allocate memory for control request");
-#endif
-		usb_free_urb(urb);
-		return;
-	}
+	if (i == AX_ASYNC_SLOTS || size > AX_ASYNC_DATA_LEN)
+		return NULL;
 
-	asyncdata = (struct ax88179_async_handle*)
-			kmalloc(sizeof(struct ax88179_async_handle), GFP_ATOMIC);
-	if (asyncdata == NULL) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_err(dev->net, "Failed to allocate memory for async data");
-#else
-		deverr(dev, "Failed to allocate memory for async data");
-#endif
-		kfree(req);
-		usb_free_urb(urb);
+	slot->used = 1;
+	slot->size = size;
+	slot->req.bRequestType = USB_DIR_OUT | USB_TYPE_VENDOR |
+				 USB_RECIP_DEVICE;
+	slot->req.bRequest = cmd;
+	slot->req.wValue = cpu_to_le16(value);
+	slot->req.wIndex = cpu_to_le16(index);
+	slot->req.wLength = cpu_to_le16(size);
+
+	usb_fill_control_urb(slot->urb, priv->dev->udev,
+			     usb_sndctrlpipe(priv->dev->udev, 0),
+			     (void *)&slot->req, slot->data, size,
+			     ax88179_async_cmd_callback, slot);
+	return slot;
+}
+
+/* A synchronous write to a MAC register makes its async slot stale */
+static void ax88179_async_forget(struct ax88179_priv *priv, u16 reg)
+{
+	unsigned long flags;
+	int i;
+
+	if (!priv)
 		return;
-	}
 
-	asyncdata->req = req;
-	
-	if (size == 2) {
-		asyncdata->rxctl = *((u16 *)data);
-		cpu_to_le16s(&asyncdata->rxctl);
-		buf = &asyncdata->rxctl;
-	} else {
-		memcpy(asyncdata->m_filter, data, size);
-		buf = asyncdata->m_filter;
+	spin_lock_irqsave(&priv->async_lock, flags);
+	for (i = 0; i < AX_ASYNC_SLOTS; i++) {
+		if (priv->async[i].req.bRequest == AX_ACCESS_MAC &&
+		    (reg == AX_PHYPWR_RSTCTL ||
+		     priv->async[i].req.wValue == cpu_to_le16(reg)))
+			priv->async[i].known = 0;
 	}
+	spin_unlock_irqrestore(&priv->async_lock, flags);
+}
+
+/* Write a register from atomic context through the preallocated slots.
+ * A write that would not change the register is dropped, and while a
+ * write is in flight only the latest of the values that follow is sent.
+ */
+static void
+ax88179_write_cmd_async(struct usbnet *dev, u8 cmd, u16 value, u16 index,
+				    u16 size, void *data)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct ax88179_async_handle *slot;
+	u8 buf[AX_ASYNC_DATA_LEN];
+	unsigned long flags;
+	int status = 0;
+	u64 bits;
 
-	req->bRequestType = USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_DEVICE;
-	req->bRequest = cmd;
-	req->wValue = cpu_to_le16(value);
-	req->wIndex = cpu_to_le16(index);
-	req->wLength = cpu_to_le16(size);
+	if (!priv)
+		return;
 
-	usb_fill_control_urb(urb, dev->udev,
-			     usb_sndctrlpipe(dev->udev, 0),
-			     (void *)req, buf, size,
-			     ax88179_async_cmd_callback, asyncdata);
+	if (size == 2)
+		*(__le16 *)buf = cpu_to_le16(*(u16 *)data);
+	else if (size <= AX_ASYNC_DATA_LEN)
+		memcpy(buf, data, size);
+
+	/* The result is not waited for, so forget the register */
+	bits = ax88179_reg_bits(priv, cmd, value, size);
+	if (bits)
+		ax88179_reg_set(priv, bits, value, NULL, size);
+
+	spin_lock_irqsave(&priv->async_lock, flags);
+	slot = ax88179_async_slot(priv, cmd, value, index, size);
+	if (!slot) {
+		status = -ENOSPC;
+	} else if (slot->busy) {
+		/* Supersede what is still waiting, the same value in
+		 * flight needs nothing more
+		 */
+		slot->dirty = !!memcmp(slot->data, buf, size);
+		memcpy(slot->next, buf, size);
+	} else if (!slot->known || memcmp(slot->data, buf, size)) {
+		memcpy(slot->data, buf, size);
+		status = ax88179_async_submit(slot);
+	}
+	spin_unlock_irqrestore(&priv->async_lock, flags);
 
-	status = usb_submit_urb(urb, GFP_ATOMIC);
 	if (status < 0) {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 		netdev_err(dev->net, "Error submitting the control message: status=%d",
@@ -324,137 +627,561 @@ ax88179_write_cmd_async(struct usbnet *dev, u8 cmd, u16 value, u16 index,
 		deverr(dev, "Error submitting the control message: status=%d",
 		       status);
 #endif
-		kfree(req);
-		kfree(asyncdata);
-		usb_free_urb(urb);
 	}
 }
 
-static void ax88179_status(struct usbnet *dev, struct urb *urb)
+/* A command sequence queues vendor reads and writes that need no delay
+ * between them and submits them together with ax88179_seq_run(), which
+ * waits once. Control URBs on endpoint 0 complete in submission order,
+ * so the device sees the commands as queued. Without AX_CMD_SEQ every
+ * command is issued synchronously when it is queued.
+ */
+static struct ax88179_seq *ax88179_seq_alloc(struct usbnet *dev)
 {
-	struct ax88179_int_data *event = NULL;
-	int link = 0;
-
-	if (urb->actual_length < 8)
-		return;
+	struct ax88179_seq *seq;
 
-	event = urb->transfer_buffer;
-	link = event->link & AX_INT_PPLS_LINK;
+	seq = kzalloc(sizeof(*seq), GFP_KERNEL);
+	if (!seq)
+		return NULL;
 
-	if (netif_carrier_ok(dev->net) != link) {
-		if (link)
-			usbnet_defer_kevent(dev, EVENT_LINK_RESET);
-		else
-			netif_carrier_off(dev->net);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_info(dev->net, "ax88179_178a - Link status is: %d\n",
-			    link);
-#else
-		devinfo(dev, "ax88179_178a - Link status is: %d\n", link);
+	seq->dev = dev;
+#ifdef AX_CMD_SEQ
+	init_usb_anchor(&seq->anchor);
+	init_completion(&seq->done);
 #endif
-	}
+	return seq;
 }
 
-static int ax88179_mdio_read(struct net_device *netdev, int phy_id, int loc)
+static void ax88179_seq_error(struct ax88179_seq *seq, int status)
 {
-	struct usbnet *dev = netdev_priv(netdev);
-	u16 res;
-	u16 *tmp16;
-
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
+	cmpxchg(&seq->status, 0, status);
+}
 
-	ax88179_read_cmd(dev, AX_ACCESS_PHY, phy_id, (__u16)loc, 2, tmp16, 1);
+#ifdef AX_CMD_SEQ
+static struct ax88179_seq_cmd *
+ax88179_seq_add(struct ax88179_seq *seq, u8 dir, u8 cmd, u16 value,
+		u16 index, u16 size)
+{
+	struct ax88179_seq_cmd *c;
 
-	res = *tmp16;
-	kfree(tmp16);
+	if (WARN_ON(seq->count == AX_SEQ_MAX || size > AX_SEQ_DATA_LEN)) {
+		ax88179_seq_error(seq, -EINVAL);
+		return NULL;
+	}
 
-	return res;
+	c = &seq->cmd[seq->count++];
+	c->req.bRequestType = dir | USB_TYPE_VENDOR | USB_RECIP_DEVICE;
+	c->req.bRequest = cmd;
+	c->req.wValue = cpu_to_le16(value);
+	c->req.wIndex = cpu_to_le16(index);
+	c->req.wLength = cpu_to_le16(size);
+	return c;
 }
+#endif
 
-static void ax88179_mdio_write(struct net_device *netdev, int phy_id, int loc,
-			       int val)
+/* Queue a write, data as for ax88179_write_cmd() */
+static void ax88179_seq_write(struct ax88179_seq *seq, u8 cmd, u16 value,
+			      u16 index, u16 size, const void *data)
 {
-	struct usbnet *dev = netdev_priv(netdev);
-	u16 *res;
-	res = kmalloc(2, GFP_KERNEL);
-	if (!res)
+#ifdef AX_CMD_SEQ
+	struct ax88179_seq_cmd *c;
+
+	c = ax88179_seq_add(seq, USB_DIR_OUT, cmd, value, index, size);
+	if (!c)
 		return;
-	*res = (u16)val;
 
-	ax88179_write_cmd(dev, AX_ACCESS_PHY, phy_id, (__u16)loc, 2, res);
+	if (size == 2)
+		*(__le16 *)c->data = cpu_to_le16(*(const u16 *)data);
+	else if (size)
+		memcpy(c->data, data, size);
+#else
+	int ret;
 
-	kfree(res);
+	ret = ax88179_write_cmd(seq->dev, cmd, value, index, size,
+				(void *)data);
+	if (ret < 0)
+		ax88179_seq_error(seq, ret);
+#endif
 }
 
-static int ax88179_suspend(struct usb_interface *intf,
-#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 10)
-			   pm_message_t message)
+/* Queue a read, data is filled in by ax88179_seq_run() */
+static void ax88179_seq_read(struct ax88179_seq *seq, u8 cmd, u16 value,
+			     u16 index, u16 size, void *data, int eflag)
+{
+#ifdef AX_CMD_SEQ
+	struct ax88179_seq_cmd *c;
+
+	c = ax88179_seq_add(seq, USB_DIR_IN, cmd, value, index, size);
+	if (!c)
+		return;
+
+	c->dest = data;
+	c->eflag = eflag;
 #else
-			   u32 message)
+	int ret;
+
+	ret = ax88179_read_cmd(seq->dev, cmd, value, index, size, data, eflag);
+	if (ret < 0)
+		ax88179_seq_error(seq, ret);
 #endif
+}
+
+#ifdef AX_CMD_SEQ
+static void ax88179_seq_complete(struct urb *urb)
 {
-	struct usbnet *dev = usb_get_intfdata(intf);
-	struct ax88179_data *ax179_data = (struct ax88179_data *)dev->data;
-	u8 wolp[38] = { 0 };
-	u16 tmp16;
-	u8 tmp8;
+	struct ax88179_seq *seq = urb->context;
 
-	usbnet_suspend(intf, message);
+	if (urb->status < 0)
+		ax88179_seq_error(seq, urb->status);
 
-	/* Disable RX path */
-	ax88179_read_cmd_nopm(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			      2, 2, &tmp16, 1);
-	tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC,  AX_MEDIUM_STATUS_MODE,
-			       2, 2, &tmp16);
+	if (atomic_dec_and_test(&seq->pending))
+		complete(&seq->done);
+}
 
-	/* Force bz */
-	ax88179_read_cmd_nopm(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
-			      2, 2, &tmp16, 1);
-	tmp16 |= AX_PHYPWR_RSTCTL_BZ | AX_PHYPWR_RSTCTL_IPRL;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
-			       2, 2, &tmp16);
+static int ax88179_seq_submit(struct ax88179_seq *seq,
+			      struct ax88179_seq_cmd *c)
+{
+	struct usb_device *udev = seq->dev->udev;
+	unsigned int pipe;
+	int ret;
 
-	wolp[28] = 0x04;
-	wolp[29] = MASK_WAKEUP_EVENT_TIMER;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_WAKEUP, 0x01, 0, 38, wolp);
+	c->urb = usb_alloc_urb(0, GFP_KERNEL);
+	if (!c->urb)
+		return -ENOMEM;
 
-	/* change clock */	
-	tmp8 = 0;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_CLK_SELECT, 1, 1, &tmp8);
+	if (c->req.bRequestType & USB_DIR_IN)
+		pipe = usb_rcvctrlpipe(udev, 0);
+	else
+		pipe = usb_sndctrlpipe(udev, 0);
 
-	/* Configure RX control register => stop operation */
-	tmp16 = AX_RX_CTL_STOP;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
+	usb_fill_control_urb(c->urb, udev, pipe, (u8 *)&c->req, c->data,
+			     le16_to_cpu(c->req.wLength),
+			     ax88179_seq_complete, seq);
+	usb_anchor_urb(c->urb, &seq->anchor);
 
-	tmp8 = ax179_data->reg_monitor;
-	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp8);
-	
-	return 0;
+	ret = usb_submit_urb(c->urb, GFP_KERNEL);
+	if (ret < 0)
+		usb_unanchor_urb(c->urb);
+
+	return ret;
 }
 
+/* Hand the result of a finished command to its caller and the shadow */
+static void ax88179_seq_finish(struct ax88179_seq *seq,
+			       struct ax88179_seq_cmd *c)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(seq->dev);
+	u16 value = le16_to_cpu(c->req.wValue);
+	u16 size = le16_to_cpu(c->req.wLength);
+	bool ok = c->urb && !c->urb->status && c->urb->actual_length == size;
+	u64 bits;
+
+	bits = ax88179_reg_bits(priv, c->req.bRequest, value, size);
+	if (bits)
+		ax88179_reg_set(priv, bits, value, ok ? c->data : NULL, size);
+	if (c->req.bRequest == AX_ACCESS_MAC && !c->dest)
+		ax88179_async_forget(priv, value);
+
+	if (!ok || !c->dest)
+		return;
+
+	if (c->eflag && size == 2)
+		*(u16 *)c->dest = le16_to_cpup((__le16 *)c->data);
+	else if (c->eflag && size == 4)
+		*(u32 *)c->dest = le32_to_cpup((__le32 *)c->data);
+	else
+		memcpy(c->dest, c->data, size);
+}
+#endif
 
-static void ax88179_EEE_setting(struct usbnet *dev)
+/* Submit the queued commands and wait for all of them. The first error
+ * is returned; reads that failed leave their buffer untouched. The
+ * sequence is empty again afterwards.
+ */
+static int ax88179_seq_run(struct ax88179_seq *seq)
 {
-	u16 tmp16;
-	
-	if (bEEE) {
-		// Enable EEE
-		tmp16 = 0x07;
-		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
-				  GMII_PHY_MACR, 2, &tmp16);
+#ifdef AX_CMD_SEQ
+	struct usbnet *dev = seq->dev;
+	int i, ret;
 
-		tmp16 = 0x3c;
-		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
-				  GMII_PHY_MAADR, 2, &tmp16);
+	if (!seq->count)
+		return seq->status;
 
-		tmp16 = 0x4007;
-		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
-				  GMII_PHY_MACR, 2, &tmp16);
+	ret = usb_autopm_get_interface(dev->intf);
+	if (ret < 0) {
+		ax88179_seq_error(seq, ret);
+		goto out;
+	}
 
-		tmp16 = 0x06;
+	atomic_set(&seq->pending, seq->count);
+	for (i = 0; i < seq->count; i++) {
+		ret = ax88179_seq_submit(seq, &seq->cmd[i]);
+		if (ret < 0)
+			break;
+	}
+
+	/* Commands not submitted are done as well */
+	if (i < seq->count) {
+		ax88179_seq_error(seq, ret);
+		if (atomic_sub_and_test(seq->count - i, &seq->pending))
+			complete(&seq->done);
+	}
+
+	if (!wait_for_completion_timeout(&seq->done,
+			msecs_to_jiffies(USB_CTRL_SET_TIMEOUT))) {
+		usb_kill_anchored_urbs(&seq->anchor);
+		ax88179_seq_error(seq, -ETIMEDOUT);
+	}
+
+	usb_autopm_put_interface(dev->intf);
+
+out:
+	for (i = 0; i < seq->count; i++) {
+		ax88179_seq_finish(seq, &seq->cmd[i]);
+		usb_free_urb(seq->cmd[i].urb);
+	}
+	memset(seq->cmd, 0, sizeof(seq->cmd));
+	seq->count = 0;
+	reinit_completion(&seq->done);
+
+	if (seq->status < 0)
+		netdev_warn(dev->net, "Failed command sequence: %d\n",
+			    seq->status);
+#endif
+	return seq->status;
+}
+
+#ifdef AX_PHY_CACHE
+static const u8 ax88179_phy_regs[AX_PHY_CACHED] = {
+	[AX_PHY_BMCR]		= MII_BMCR,
+	[AX_PHY_BMSR]		= MII_BMSR,
+	[AX_PHY_ADVERTISE]	= MII_ADVERTISE,
+	[AX_PHY_LPA]		= MII_LPA,
+	[AX_PHY_CTRL1000]	= MII_CTRL1000,
+	[AX_PHY_STAT1000]	= MII_STAT1000,
+	[AX_PHY_PHYSR]		= GMII_PHY_PHYSR,
+};
+
+static int ax88179_phy_index(int phy_id, int loc)
+{
+	int i;
+
+	if (phy_id != AX88179_PHY_ID)
+		return -1;
+
+	for (i = 0; i < AX_PHY_CACHED; i++)
+		if (ax88179_phy_regs[i] == loc)
+			return i;
+
+	return -1;
+}
+
+static void ax88179_phy_invalidate(struct ax88179_priv *priv, u8 mask)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	priv->phy_valid &= ~mask;
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+}
+
+/* Read all cached registers in one command sequence */
+static void ax88179_phy_refresh(struct usbnet *dev)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct ax88179_seq *seq;
+	u16 regs[AX_PHY_CACHED];
+	unsigned long flags;
+	int i;
+
+	seq = ax88179_seq_alloc(dev);
+	if (!seq)
+		return;
+
+	for (i = 0; i < AX_PHY_CACHED; i++)
+		ax88179_seq_read(seq, AX_ACCESS_PHY, AX88179_PHY_ID,
+				 ax88179_phy_regs[i], 2, &regs[i], 1);
+
+	if (!ax88179_seq_run(seq)) {
+		spin_lock_irqsave(&priv->reg_lock, flags);
+		if (priv->phy_on) {
+			memcpy(priv->phy_cache, regs, sizeof(regs));
+			priv->phy_valid = BIT(AX_PHY_CACHED) - 1;
+		}
+		spin_unlock_irqrestore(&priv->reg_lock, flags);
+	}
+	kfree(seq);
+}
+
+static bool ax88179_phy_running(struct ax88179_priv *priv)
+{
+	unsigned long flags;
+	bool on;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	on = priv->phy_on;
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	return on;
+}
+
+static void ax88179_phy_work(struct work_struct *work)
+{
+	struct ax88179_priv *priv = container_of(work, struct ax88179_priv,
+						 phy_work.work);
+
+	if (!ax88179_phy_running(priv))
+		return;
+
+	ax88179_phy_refresh(priv->dev);
+	schedule_delayed_work(&priv->phy_work, AX_PHY_REFRESH);
+}
+
+static void ax88179_phy_start(struct ax88179_priv *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	priv->phy_on = 1;
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	mod_delayed_work(system_wq, &priv->phy_work, 0);
+}
+
+/* Queries go to the PHY until the next ax88179_phy_start(); nothing is
+ * cached once phy_on is clear, so the cache stays empty
+ */
+static void ax88179_phy_stop(struct ax88179_priv *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	priv->phy_on = 0;
+	priv->phy_valid = 0;
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	cancel_delayed_work_sync(&priv->phy_work);
+}
+#endif
+
+#ifdef AX_LINK_WORK
+/* Status interrupt context; returns whether the link bit changed */
+static bool ax88179_link_event(struct usbnet *dev, int link)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	if (!link)
+		netif_carrier_off(dev->net);
+
+	if (!netif_running(dev->net) || priv->link_up == link)
+		return false;
+
+	priv->link_up = link;
+	mod_delayed_work(system_wq, &priv->link_work, 0);
+#ifdef AX_PHY_CACHE
+	/* Until phy_work has read the new state */
+	ax88179_phy_invalidate(priv, AX_PHY_STATUS_MASK);
+	if (ax88179_phy_running(priv))
+		mod_delayed_work(system_wq, &priv->phy_work, 0);
+#endif
+
+	return true;
+}
+#endif
+
+static void ax88179_status(struct usbnet *dev, struct urb *urb)
+{
+	struct ax88179_int_data *event = NULL;
+	int link = 0;
+
+	if (urb->actual_length < 8)
+		return;
+
+	event = urb->transfer_buffer;
+	link = event->link & AX_INT_PPLS_LINK;
+
+	if (netif_carrier_ok(dev->net) != link) {
+#ifdef AX_LINK_WORK
+		if (!ax88179_link_event(dev, link))
+			return;
+#else
+		if (link)
+			usbnet_defer_kevent(dev, EVENT_LINK_RESET);
+		else
+			netif_carrier_off(dev->net);
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+		netdev_info(dev->net, "ax88179_178a - Link status is: %d\n",
+			    link);
+#else
+		devinfo(dev, "ax88179_178a - Link status is: %d\n", link);
+#endif
+	}
+}
+
+#ifdef AX_PHY_CACHE
+static bool ax88179_phy_get(struct ax88179_priv *priv, int i, u16 *val)
+{
+	unsigned long flags;
+	bool hit;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	hit = priv->phy_valid & BIT(i);
+	if (hit)
+		*val = priv->phy_cache[i];
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+
+	return hit;
+}
+
+static void ax88179_phy_set(struct ax88179_priv *priv, int i, u16 val)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->reg_lock, flags);
+	if (priv->phy_on) {
+		priv->phy_cache[i] = val;
+		priv->phy_valid |= BIT(i);
+	}
+	spin_unlock_irqrestore(&priv->reg_lock, flags);
+}
+#endif
+
+static int ax88179_mdio_read(struct net_device *netdev, int phy_id, int loc)
+{
+	struct usbnet *dev = netdev_priv(netdev);
+#ifdef AX_PHY_CACHE
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	int i = ax88179_phy_index(phy_id, loc);
+#endif
+	u16 res;
+	int ret;
+
+#ifdef AX_PHY_CACHE
+	if (i >= 0 && ax88179_phy_get(priv, i, &res))
+		return res;
+#endif
+
+	ret = ax88179_read_cmd(dev, AX_ACCESS_PHY, phy_id, (__u16)loc, 2,
+			       &res, 1);
+	if (ret < 2)
+		return ret < 0 ? ret : 0;
+
+#ifdef AX_PHY_CACHE
+	if (i >= 0)
+		ax88179_phy_set(priv, i, res);
+#endif
+
+	return res;
+}
+
+static void ax88179_mdio_write(struct net_device *netdev, int phy_id, int loc,
+			       int val)
+{
+	struct usbnet *dev = netdev_priv(netdev);
+#ifdef AX_PHY_CACHE
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	int i = ax88179_phy_index(phy_id, loc);
+#endif
+	u16 res = (u16)val;
+	int ret;
+
+	ret = ax88179_write_cmd(dev, AX_ACCESS_PHY, phy_id, (__u16)loc, 2,
+				&res);
+
+#ifdef AX_PHY_CACHE
+	/* Advertisement sticks until BMCR restarts autoneg or resets; after
+	 * a failed write the register is read back from the PHY
+	 */
+	if (ret < 0 && i >= 0)
+		ax88179_phy_invalidate(priv, BIT(i));
+	else if (i == AX_PHY_ADVERTISE || i == AX_PHY_CTRL1000)
+		ax88179_phy_set(priv, i, (u16)val);
+	else if (i >= 0)
+		ax88179_phy_invalidate(priv, BIT(AX_PHY_CACHED) - 1);
+#endif
+}
+
+static int ax88179_suspend(struct usb_interface *intf,
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 10)
+			   pm_message_t message)
+#else
+			   u32 message)
+#endif
+{
+	struct usbnet *dev = usb_get_intfdata(intf);
+	struct ax88179_data *ax179_data = (struct ax88179_data *)dev->data;
+	u8 wolp[38] = { 0 };
+	u16 tmp16;
+	u8 tmp8;
+
+	usbnet_suspend(intf, message);
+	ax179_data->priv->hw_ready = 0;
+#ifdef AX_LINK_WORK
+	ax88179_link_stop(ax179_data->priv);
+#endif
+#ifdef AX_PHY_CACHE
+	ax88179_phy_stop(ax179_data->priv);
+#endif
+#ifdef AX_NAPI_RX
+	ax88179_rx_ring_stop(ax179_data->priv);
+#endif
+#ifdef AX_XDP
+	ax88179_xdp_tx_stop(ax179_data->priv);
+#endif
+
+	/* Disable RX path */
+	ax88179_read_cmd_nopm(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+			      2, 2, &tmp16, 1);
+	tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC,  AX_MEDIUM_STATUS_MODE,
+			       2, 2, &tmp16);
+
+	/* Force bz */
+	ax88179_read_cmd_nopm(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
+			      2, 2, &tmp16, 1);
+	tmp16 |= AX_PHYPWR_RSTCTL_BZ | AX_PHYPWR_RSTCTL_IPRL;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
+			       2, 2, &tmp16);
+
+	wolp[28] = 0x04;
+	wolp[29] = MASK_WAKEUP_EVENT_TIMER;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_WAKEUP, 0x01, 0, 38, wolp);
+
+	/* change clock */	
+	tmp8 = 0;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_CLK_SELECT, 1, 1, &tmp8);
+
+	/* Configure RX control register => stop operation */
+	tmp16 = AX_RX_CTL_STOP;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
+
+	tmp8 = ax179_data->reg_monitor;
+	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp8);
+	
+	return 0;
+}
+
+
+static void ax88179_EEE_setting(struct usbnet *dev)
+{
+	u16 tmp16;
+	
+	if (bEEE) {
+		// Enable EEE
+		tmp16 = 0x07;
+		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
+				  GMII_PHY_MACR, 2, &tmp16);
+
+		tmp16 = 0x3c;
+		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
+				  GMII_PHY_MAADR, 2, &tmp16);
+
+		tmp16 = 0x4007;
+		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
+				  GMII_PHY_MACR, 2, &tmp16);
+
+		tmp16 = 0x06;
 		ax88179_write_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
 				  GMII_PHY_MAADR, 2, &tmp16);
 	} else {
@@ -521,6 +1248,10 @@ static void ax88179_Gether_setting(struct usbnet *dev)
 static int ax88179_resume(struct usb_interface *intf)
 {
 	struct usbnet *dev = usb_get_intfdata(intf);
+#ifdef AX_NAPI_RX
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	int ret;
+#endif
 	u16 tmp16;
 	u8 tmp8;
 
@@ -557,7 +1288,21 @@ static int ax88179_resume(struct usb_interface *intf)
 		tmp16 |= AX_RX_CTL_IPE;
 	ax88179_write_cmd_nopm(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
 
+#ifdef AX_PHY_CACHE
+	if (netif_running(dev->net))
+		ax88179_phy_start(ax88179_get_priv(dev));
+#endif
+
+#ifdef AX_NAPI_RX
+	ret = usbnet_resume(intf);
+	if (!ret && netif_running(dev->net) &&
+	    (priv->flags & AX_PRIV_FLAG_RX_NAPI))
+		ax88179_rx_ring_start(priv);
+
+	return ret;
+#else
 	return usbnet_resume(intf);
+#endif
 }
 
 static void
@@ -703,19 +1448,13 @@ static int ax88179_ioctl(struct net_device *net, struct ifreq *rq, int cmd)
 static int ax88179_netdev_stop(struct net_device *net)
 {
 	struct usbnet *dev = netdev_priv(net);
-	u16 *tmp16;
-
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
+	u16 tmp16;
 
 	ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			 2, 2, tmp16, 1);
-	*tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
+			 2, 2, &tmp16, 1);
+	tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
 	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			  2, 2, tmp16);
-
-	kfree(tmp16);	
+			  2, 2, &tmp16);
 
 	return 0;
 }
@@ -726,27 +1465,21 @@ static int ax88179_netdev_stop(struct net_device *net)
 static int ax88179_set_csums(struct usbnet *dev)
 {
 	struct ax88179_data *ax179_data = (struct ax88179_data *)dev->data;
-	u8* checksum = 0;
-
-	checksum = kmalloc(1, GFP_KERNEL);
-	if (!checksum)
-		return -ENOMEM;
+	u8 checksum;
 
 	if (ax179_data->checksum & AX_RX_CHECKSUM)
-		*checksum = AX_RXCOE_DEF_CSUM;
+		checksum = AX_RXCOE_DEF_CSUM;
 	else
-		*checksum = 0;
+		checksum = 0;
 
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, checksum);
+	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &checksum);
 
 	if (ax179_data->checksum & AX_TX_CHECKSUM)
-		*checksum = AX_TXCOE_DEF_CSUM;
+		checksum = AX_TXCOE_DEF_CSUM;
 	else
-		*checksum = 0;
-
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, checksum);
+		checksum = 0;
 
-	kfree(checksum);
+	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &checksum);
 
 	return 0;
 }
@@ -803,45 +1536,511 @@ static int ax88179_set_tso(struct net_device *netdev, u32 data)
 }
 #endif
 
-static struct ethtool_ops ax88179_ethtool_ops = {
-	.get_drvinfo		= ax88179_get_drvinfo,
-	.get_link		= ethtool_op_get_link,
-	.get_msglevel		= usbnet_get_msglevel,
-	.set_msglevel		= usbnet_set_msglevel,
-	.get_wol		= ax88179_get_wol,
-	.set_wol		= ax88179_set_wol,
-	.get_eeprom_len		= ax88179_get_eeprom_len,
-	.get_eeprom		= ax88179_get_eeprom,
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 12, 0)
-	.get_settings		= ax88179_get_settings,
-	.set_settings		= ax88179_set_settings,
-#else
-	.get_link_ksettings	= ax88179_get_link_ksettings,
-	.set_link_ksettings	= ax88179_set_link_ksettings,
-#endif
-#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 3, 0)
-	.set_tx_csum		= ax88179_set_tx_csum,
-	.get_tx_csum		= ax88179_get_tx_csum,
-	.get_rx_csum		= ax88179_get_rx_csum,
-	.set_rx_csum		= ax88179_set_rx_csum,
-	.get_tso		= ethtool_op_get_tso,
-	.set_tso		= ax88179_set_tso,
-	.get_sg			= ethtool_op_get_sg,
-	.set_sg			= ethtool_op_set_sg
-#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+static const char ax88179_priv_flags_strings[][ETH_GSTRING_LEN] = {
+	"rx-napi",
+	"tx-aggregation",
+	"tx-xmit-more",
+	"tx-prio",
 };
 
-static void ax88179_set_multicast(struct net_device *net)
-{
-	struct usbnet *dev = netdev_priv(net);
-	struct ax88179_data *data = (struct ax88179_data *)&dev->data;
-	u8 *m_filter = ((u8 *)dev->data) + 12;
-	int mc_count = 0;
+static const char ax88179_stats_strings[][ETH_GSTRING_LEN] = {
+	"rx_pool_hit",
+	"rx_pool_miss",
+	"rx_xdp_drop",
+	"rx_xdp_tx",
+	"rx_xdp_redirect",
+	"rx_xdp_aborted",
+	"rx_xsk_nobuf",
+	"tx_xsk_frames",
+	"tx_agg_urbs",
+	"tx_agg_frames",
+	"tx_agg_timeout",
+	"tx_xmit_more",
+	"tx_burst_end",
+	"tx_sg",
+	"tx_bounce",
+	"tx_pull",
+	"tx_head_copy",
+	"tx_prio",
+	"tx_prio_bypass",
+};
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 35)
-	mc_count = net->mc_count;
+#define AX_STATS_LEN	(sizeof(struct ax88179_stats) / sizeof(u64))
+
+static int ax88179_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+#if defined(AX_RX_PAGE_POOL) && defined(CONFIG_PAGE_POOL_STATS)
+		return AX_STATS_LEN + page_pool_ethtool_stats_get_count();
 #else
-	mc_count = netdev_mc_count(net);
+		return AX_STATS_LEN;
+#endif
+	case ETH_SS_PRIV_FLAGS:
+		return ARRAY_SIZE(ax88179_priv_flags_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void ax88179_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	BUILD_BUG_ON(ARRAY_SIZE(ax88179_stats_strings) != AX_STATS_LEN);
+
+	switch (sset) {
+	case ETH_SS_STATS:
+		memcpy(data, ax88179_stats_strings,
+		       sizeof(ax88179_stats_strings));
+#if defined(AX_RX_PAGE_POOL) && defined(CONFIG_PAGE_POOL_STATS)
+		page_pool_ethtool_stats_get_strings(data +
+						    sizeof(ax88179_stats_strings));
+#endif
+		break;
+	case ETH_SS_PRIV_FLAGS:
+		memcpy(data, ax88179_priv_flags_strings,
+		       sizeof(ax88179_priv_flags_strings));
+		break;
+	}
+}
+
+static void ax88179_get_ethtool_stats(struct net_device *net,
+				      struct ethtool_stats *stats, u64 *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+#if defined(AX_RX_PAGE_POOL) && defined(CONFIG_PAGE_POOL_STATS)
+	struct page_pool_stats pp_stats = { 0 };
+#endif
+
+	memcpy(data, &priv->stats, sizeof(priv->stats));
+
+#if defined(AX_RX_PAGE_POOL) && defined(CONFIG_PAGE_POOL_STATS)
+	if (priv->rx_pool)
+		page_pool_get_stats(priv->rx_pool, &pp_stats);
+	page_pool_ethtool_stats_get(data + AX_STATS_LEN, &pp_stats);
+#endif
+}
+
+static u32 ax88179_get_priv_flags(struct net_device *net)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	return ax88179_get_priv(dev)->flags;
+}
+
+static int ax88179_set_priv_flags(struct net_device *net, u32 flags)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	/* Nothing changes unless every flag can be applied */
+#ifndef AX_TX_AGG
+	if (flags & (AX_PRIV_FLAGS_TX_PACK | AX_PRIV_FLAG_TX_PRIO))
+		return -EOPNOTSUPP;
+#endif
+#ifndef AX_NAPI_RX
+	if (flags & AX_PRIV_FLAG_RX_NAPI)
+		return -EOPNOTSUPP;
+#endif
+#ifdef AX_XDP
+	/* XDP only runs on the NAPI ring */
+	if (priv->xdp_prog && !(flags & AX_PRIV_FLAG_RX_NAPI))
+		return -EBUSY;
+#endif
+#ifdef AX_XSK
+	if (priv->xsk_pool && !(flags & AX_PRIV_FLAG_RX_NAPI))
+		return -EBUSY;
+#endif
+
+#ifdef AX_TX_AGG
+	/* Frames already aggregated go out right away */
+	if ((priv->flags & AX_PRIV_FLAGS_TX_PACK) &&
+	    !(flags & AX_PRIV_FLAGS_TX_PACK)) {
+		netif_tx_lock_bh(net);
+		priv->flags &= ~AX_PRIV_FLAGS_TX_PACK;
+		ax88179_tx_agg_close(dev, priv);
+		netif_tx_unlock_bh(net);
+		tasklet_schedule(&priv->tx_agg_bh);
+	}
+#endif
+#ifdef AX_NAPI_RX
+	/* Transfers already queued for NAPI are still drained by the poll */
+	if (((priv->flags ^ flags) & AX_PRIV_FLAG_RX_NAPI) &&
+	    netif_running(net)) {
+		if (flags & AX_PRIV_FLAG_RX_NAPI) {
+			usbnet_pause_rx(dev);
+			usbnet_unlink_rx_urbs(dev);
+			priv->flags = flags;
+			ax88179_rx_ring_start(priv);
+		} else {
+			ax88179_rx_ring_stop(priv);
+			priv->flags = flags;
+			usbnet_resume_rx(dev);
+		}
+	}
+#endif
+	priv->flags = flags;
+
+	return 0;
+}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
+static int ax88179_get_tunable(struct net_device *net,
+			       const struct ethtool_tunable *tuna, void *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = ax88179_get_priv(dev)->rx_copybreak;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int ax88179_set_tunable(struct net_device *net,
+			       const struct ethtool_tunable *tuna,
+			       const void *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	u32 val;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		val = *(const u32 *)data;
+		if (val > AX_RX_COPYBREAK_MAX)
+			return -EINVAL;
+		ax88179_get_priv(dev)->rx_copybreak = val;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+#endif
+
+/* adaptive-rx profiles, from lowest latency to full aggregation; the
+ * timer is scaled from the link speed default of AX88179_BULKIN_SIZE[].
+ */
+static const struct {
+	u8	size;		/* KB */
+	u8	timer_pct;
+} ax88179_dim_profiles[] = {
+	{0,  0},
+	{4,  25},
+	{8,  50},
+	{18, 100},
+	{24, 200},
+};
+
+#define AX_DIM_DEFAULT_PROFILE	3
+
+static u32 ax88179_usecs_to_timer(u32 usecs)
+{
+	return min_t(u32, DIV_ROUND_UP(usecs * NSEC_PER_USEC,
+				       AX_BULKIN_TIMER_NS),
+		     AX_BULKIN_TIMER_MAX);
+}
+
+static u32 ax88179_timer_to_usecs(const u8 *bulkin)
+{
+	return (bulkin[1] | (bulkin[2] << 8)) * AX_BULKIN_TIMER_NS /
+	       NSEC_PER_USEC;
+}
+
+/* Bulk-in setting for the current link: the speed default from
+ * AX88179_BULKIN_SIZE[] with this interface's coalescing overrides.
+ */
+static void ax88179_bulkin_config(struct ax88179_priv *priv, u8 *tmp)
+{
+	memcpy(tmp, &AX88179_BULKIN_SIZE[priv->bulkin_row], 5);
+
+	if (priv->rx_dim_on) {
+		u32 timer = tmp[1] | (tmp[2] << 8);
+
+		timer = timer *
+			ax88179_dim_profiles[priv->rx_dim_profile].timer_pct / 100;
+		timer = min_t(u32, timer, AX_BULKIN_TIMER_MAX);
+
+		tmp[1] = (u8)timer;
+		tmp[2] = (u8)(timer >> 8);
+		tmp[3] = ax88179_dim_profiles[priv->rx_dim_profile].size;
+	} else if (priv->rx_coal_size >= 0) {
+		/* No aggregation, no timer */
+		if (priv->rx_coal_size == 0) {
+			tmp[1] = 0;
+			tmp[2] = 0;
+		}
+		tmp[3] = (u8)priv->rx_coal_size;
+	}
+
+	if (!priv->rx_dim_on && priv->rx_coal_usecs >= 0) {
+		u32 timer = ax88179_usecs_to_timer(priv->rx_coal_usecs);
+
+		tmp[1] = (u8)timer;
+		tmp[2] = (u8)(timer >> 8);
+	}
+
+	if (priv->rx_coal_ifg >= 0)
+		tmp[4] = (u8)priv->rx_coal_ifg;
+}
+
+/* The device closes a transfer after the frame that crosses the queue
+ * size, so bulk-in URBs need room for one more frame of the current MTU.
+ */
+static size_t ax88179_bulkin_urb_size(struct usbnet *dev, u8 size)
+{
+	size_t slack = ALIGN(dev->hard_mtu + AX_RX_FRAME_OVERHEAD, 1024);
+
+	return 1024 * size + max_t(size_t, slack, 2 * 1024);
+}
+
+static void ax88179_bulkin_apply(struct usbnet *dev, u8 *tmp)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	size_t urb_size = ax88179_bulkin_urb_size(dev, tmp[3]);
+
+	/* adaptive-rx must not unlink URBs on every profile change */
+	if (priv->rx_dim_on)
+		urb_size = ax88179_bulkin_urb_size(dev, AX_BULKIN_SIZE_MAX);
+
+	/* Grow usbnet's bulk-in URBs before the device may fill them */
+	if (urb_size > dev->rx_urb_size) {
+		dev->rx_urb_size = urb_size;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 0, 0)
+		usbnet_unlink_rx_urbs(dev);
+#endif
+	}
+
+	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_BULKIN_QCTRL, 5, 5, tmp);
+
+	dev->rx_urb_size = urb_size;
+	memcpy(priv->bulkin, tmp, 5);
+}
+
+/* Reprogram the bulk-in queue from the current settings; bulkin_lock
+ * held, so the register, priv->bulkin and rx_urb_size stay in step.
+ */
+static void __ax88179_bulkin_update(struct usbnet *dev)
+{
+	u8 tmp[5];
+
+	ax88179_bulkin_config(ax88179_get_priv(dev), tmp);
+	ax88179_bulkin_apply(dev, tmp);
+}
+
+/* Same, for a new AX88179_BULKIN_SIZE[] row; row < 0 keeps it */
+static void ax88179_bulkin_update(struct usbnet *dev, int row)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	mutex_lock(&priv->bulkin_lock);
+	if (row >= 0)
+		priv->bulkin_row = row;
+	__ax88179_bulkin_update(dev);
+	mutex_unlock(&priv->bulkin_lock);
+}
+
+#ifdef AX_RX_DIM
+static void ax88179_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct ax88179_priv *priv = container_of(dim, struct ax88179_priv,
+						 rx_dim);
+
+	mutex_lock(&priv->bulkin_lock);
+	if (priv->rx_dim_on && priv->rx_dim_profile != dim->profile_ix) {
+		priv->rx_dim_profile = dim->profile_ix;
+		__ax88179_bulkin_update(priv->dev);
+	}
+	mutex_unlock(&priv->bulkin_lock);
+
+	dim->state = DIM_START_MEASURE;
+}
+#endif
+
+/* Account one bulk-in transfer for adaptive-rx */
+static inline void ax88179_dim_count(struct ax88179_priv *priv, u16 pkt_cnt,
+				     u32 len)
+{
+#ifdef AX_RX_DIM
+	priv->rx_dim_events++;
+	priv->rx_dim_pkts += pkt_cnt;
+	priv->rx_dim_bytes += len;
+#endif
+}
+
+static void ax88179_dim_update(struct ax88179_priv *priv)
+{
+#ifdef AX_RX_DIM
+	struct dim_sample sample = {};
+
+	if (!priv->rx_dim_on)
+		return;
+
+	dim_update_sample(priv->rx_dim_events, priv->rx_dim_pkts,
+			  priv->rx_dim_bytes, &sample);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	net_dim(&priv->rx_dim, &sample);
+#else
+	net_dim(&priv->rx_dim, sample);
+#endif
+#endif
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int ax88179_get_coalesce(struct net_device *net,
+				struct ethtool_coalesce *ec,
+				struct kernel_ethtool_coalesce *kernel_coal,
+				struct netlink_ext_ack *extack)
+#else
+static int ax88179_get_coalesce(struct net_device *net,
+				struct ethtool_coalesce *ec)
+#endif
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	mutex_lock(&priv->bulkin_lock);
+	ec->rx_coalesce_usecs = ax88179_timer_to_usecs(priv->bulkin);
+	ec->rx_max_coalesced_frames = priv->bulkin[3];
+	ec->rx_coalesce_usecs_irq = DIV_ROUND_UP(priv->bulkin[4], 4);
+	ec->use_adaptive_rx_coalesce = priv->rx_dim_on;
+	mutex_unlock(&priv->bulkin_lock);
+
+	return 0;
+}
+
+/* Only the values that differ from what is running become overrides,
+ * the others keep following the link speed. rx-usecs and rx-usecs-irq 0
+ * drop the override; turning adaptive-rx on drops timer and size.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int ax88179_set_coalesce(struct net_device *net,
+				struct ethtool_coalesce *ec,
+				struct kernel_ethtool_coalesce *kernel_coal,
+				struct netlink_ext_ack *extack)
+#else
+static int ax88179_set_coalesce(struct net_device *net,
+				struct ethtool_coalesce *ec)
+#endif
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	u32 usecs, ifg;
+
+	if (ec->rx_coalesce_usecs >
+	    AX_BULKIN_TIMER_MAX * AX_BULKIN_TIMER_NS / NSEC_PER_USEC ||
+	    ec->rx_max_coalesced_frames > AX_BULKIN_SIZE_MAX ||
+	    ec->rx_coalesce_usecs_irq > DIV_ROUND_UP(AX_BULKIN_IFG_MAX, 4))
+		return -EINVAL;
+
+#ifndef AX_RX_DIM
+	if (ec->use_adaptive_rx_coalesce)
+		return -EOPNOTSUPP;
+#endif
+
+	/* Against adaptive-rx and the link work */
+	mutex_lock(&priv->bulkin_lock);
+	usecs = ax88179_timer_to_usecs(priv->bulkin);
+	ifg = DIV_ROUND_UP(priv->bulkin[4], 4);
+
+#ifdef AX_RX_DIM
+	if (ec->use_adaptive_rx_coalesce && !priv->rx_dim_on) {
+		priv->rx_dim_profile = AX_DIM_DEFAULT_PROFILE;
+		priv->rx_dim.profile_ix = AX_DIM_DEFAULT_PROFILE;
+		priv->rx_dim.state = DIM_START_MEASURE;
+	}
+#endif
+	priv->rx_dim_on = !!ec->use_adaptive_rx_coalesce;
+
+	if (priv->rx_dim_on) {
+		/* Timer and size belong to adaptive-rx while it is on */
+		priv->rx_coal_usecs = -1;
+		priv->rx_coal_size = -1;
+	} else {
+		/* Values adaptive-rx was running with are no overrides */
+		if (!ec->rx_coalesce_usecs)
+			priv->rx_coal_usecs = -1;
+		else if (ec->rx_coalesce_usecs != usecs)
+			priv->rx_coal_usecs = ec->rx_coalesce_usecs;
+
+		if (ec->rx_max_coalesced_frames != priv->bulkin[3])
+			priv->rx_coal_size = ec->rx_max_coalesced_frames;
+	}
+
+	if (!ec->rx_coalesce_usecs_irq)
+		priv->rx_coal_ifg = -1;
+	else if (ec->rx_coalesce_usecs_irq != ifg)
+		priv->rx_coal_ifg = min_t(u32, ec->rx_coalesce_usecs_irq * 4,
+					  AX_BULKIN_IFG_MAX);
+
+	__ax88179_bulkin_update(dev);
+	mutex_unlock(&priv->bulkin_lock);
+
+	return 0;
+}
+
+static const struct ethtool_ops ax88179_ethtool_ops = {
+	.get_drvinfo		= ax88179_get_drvinfo,
+	.get_link		= ethtool_op_get_link,
+	.get_msglevel		= usbnet_get_msglevel,
+	.set_msglevel		= usbnet_set_msglevel,
+	.get_wol		= ax88179_get_wol,
+	.set_wol		= ax88179_set_wol,
+	.get_eeprom_len		= ax88179_get_eeprom_len,
+	.get_eeprom		= ax88179_get_eeprom,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 12, 0)
+	.get_settings		= ax88179_get_settings,
+	.set_settings		= ax88179_set_settings,
+#else
+	.get_link_ksettings	= ax88179_get_link_ksettings,
+	.set_link_ksettings	= ax88179_set_link_ksettings,
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 3, 0)
+	.set_tx_csum		= ax88179_set_tx_csum,
+	.get_tx_csum		= ax88179_get_tx_csum,
+	.get_rx_csum		= ax88179_get_rx_csum,
+	.set_rx_csum		= ax88179_set_rx_csum,
+	.get_tso		= ethtool_op_get_tso,
+	.set_tso		= ax88179_set_tso,
+	.get_sg			= ethtool_op_get_sg,
+	.set_sg			= ethtool_op_set_sg
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+	.get_sset_count		= ax88179_get_sset_count,
+	.get_strings		= ax88179_get_strings,
+	.get_ethtool_stats	= ax88179_get_ethtool_stats,
+	.get_priv_flags		= ax88179_get_priv_flags,
+	.set_priv_flags		= ax88179_set_priv_flags,
+#endif
+	.get_coalesce		= ax88179_get_coalesce,
+	.set_coalesce		= ax88179_set_coalesce,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 7, 0)
+	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
+				     ETHTOOL_COALESCE_RX_MAX_FRAMES |
+				     ETHTOOL_COALESCE_RX_USECS_IRQ |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
+	.get_tunable		= ax88179_get_tunable,
+	.set_tunable		= ax88179_set_tunable,
+#endif
+};
+
+static void ax88179_set_multicast(struct net_device *net)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_data *data = (struct ax88179_data *)&dev->data;
+	u8 *m_filter = ((u8 *)dev->data) + 12;
+	int mc_count = 0;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 35)
+	mc_count = net->mc_count;
+#else
+	mc_count = netdev_mc_count(net);
 #endif
 
 	data->rxctl = (AX_RX_CTL_START | AX_RX_CTL_AB);
@@ -907,7 +2106,7 @@ ax88179_set_features(struct net_device *net, u32 features)
 #endif
 
 {
-	u8 *tmp8;
+	u8 tmp8;
 	struct usbnet *dev = netdev_priv(net);	
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 3, 0)
@@ -916,34 +2115,28 @@ ax88179_set_features(struct net_device *net, u32 features)
 	u32 changed = net->features ^ features;
 #endif
 
-	tmp8 = kmalloc(1, GFP_KERNEL);
-	if (!tmp8)
-		return -ENOMEM;
-
 	if (changed & NETIF_F_IP_CSUM) {
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL,
-				 1, 1, tmp8, 0);
-		*tmp8 ^= AX_TXCOE_TCP | AX_TXCOE_UDP;
-		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, tmp8);
+				 1, 1, &tmp8, 0);
+		tmp8 ^= AX_TXCOE_TCP | AX_TXCOE_UDP;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &tmp8);
 	}
 
 	if (changed & NETIF_F_IPV6_CSUM) {
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL,
-				 1, 1, tmp8, 0);
-		*tmp8 ^= AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
-		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, tmp8);
+				 1, 1, &tmp8, 0);
+		tmp8 ^= AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &tmp8);
 	}
 
 	if (changed & NETIF_F_RXCSUM) {
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL,
-				 1, 1, tmp8, 0);
-		*tmp8 ^= AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
+				 1, 1, &tmp8, 0);
+		tmp8 ^= AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
 		       AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
-		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, tmp8);
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &tmp8);
 	}
 
-	kfree(tmp8);
-
 	return 0;
 }
 #endif
@@ -951,38 +2144,41 @@ ax88179_set_features(struct net_device *net, u32 features)
 static int ax88179_change_mtu(struct net_device *net, int new_mtu)
 {
 	struct usbnet *dev = netdev_priv(net);
-	u16 *tmp16;
+	u16 tmp16;
 
 	if (new_mtu <= 0 || new_mtu > 4088)
 		return -EINVAL;
 
+#ifdef AX_XDP
+	if (ax88179_get_priv(dev)->xdp_prog &&
+	    new_mtu > (int)AX_XDP_MAX_MTU)
+		return -EINVAL;
+#endif
+
 	net->mtu = new_mtu;
 	dev->hard_mtu = net->mtu + net->hard_header_len;
 
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
-
 	if (net->mtu > 1500) {
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				 2, 2, tmp16, 1);
-		*tmp16 |= AX_MEDIUM_JUMBO_EN;
+				 2, 2, &tmp16, 1);
+		tmp16 |= AX_MEDIUM_JUMBO_EN;
 		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				  2, 2, tmp16);
+				  2, 2, &tmp16);
 	} else {
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				 2, 2, tmp16, 1);
-		*tmp16 &= ~AX_MEDIUM_JUMBO_EN;
+				 2, 2, &tmp16, 1);
+		tmp16 &= ~AX_MEDIUM_JUMBO_EN;
 		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				  2, 2, tmp16);
+				  2, 2, &tmp16);
 	}
 
+	/* Resize the bulk-in URBs for the new frame size */
+	ax88179_bulkin_update(dev, -1);
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
 	usbnet_update_max_qlen(dev);
 #endif
 
-	kfree(tmp16);
-
 	return 0;
 }
 
@@ -1008,110 +2204,324 @@ static int ax88179_set_mac_addr(struct net_device *net, void *p)
 	return 0;
 }
 
-#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 29)
-static const struct net_device_ops ax88179_netdev_ops = {
-	.ndo_open		= usbnet_open,
-	.ndo_stop		= usbnet_stop,
-	.ndo_start_xmit		= usbnet_start_xmit,
-	.ndo_tx_timeout		= usbnet_tx_timeout,
-	.ndo_change_mtu		= ax88179_change_mtu,
-	.ndo_do_ioctl		= ax88179_ioctl,
-	.ndo_set_mac_address	= ax88179_set_mac_addr,
-	.ndo_validate_addr	= eth_validate_addr,
-#if LINUX_VERSION_CODE <= KERNEL_VERSION(3, 2, 0)
-	.ndo_set_multicast_list	= ax88179_set_multicast,
-#else
-	.ndo_set_rx_mode	= ax88179_set_multicast,
-#endif
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 39)
-	.ndo_set_features	= ax88179_set_features,
-#endif
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
-	.ndo_get_stats64	= dev_get_tstats64,
-#endif
-};
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 0, 0)
+/* The MSS in tx_hdr2 only works when TCP follows the IPv6 header directly;
+ * frames with extension headers, and any super-frame over what the engine
+ * takes, are segmented by the stack.
+ */
+static netdev_features_t ax88179_features_check(struct sk_buff *skb,
+						struct net_device *net,
+						netdev_features_t features)
+{
+	if (skb_is_gso(skb) && (skb->len > AX_TSO_MAX_SIZE ||
+	    (skb_is_gso_v6(skb) && ipv6_hdr(skb)->nexthdr != IPPROTO_TCP)))
+		features &= ~NETIF_F_GSO_MASK;
+
+	return vlan_features_check(skb, features);
+}
 #endif
 
-static int ax88179_check_eeprom(struct usbnet *dev)
+#ifdef AX_NAPI_RX
+static int ax88179_open(struct net_device *net)
 {
-	u8 i = 0;
-	u8 *buf;
-	u8 *eeprom;
-	u16 csum = 0, delay = HZ / 10;
-	unsigned long jtimeout = 0;
-
-	eeprom = kmalloc(22, GFP_KERNEL);
-	if (!eeprom)
-		return -ENOMEM;
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	int ret;
+
+	napi_enable(&priv->napi);
+
+#ifdef AX_XDP
+	ret = xdp_rxq_info_reg(&priv->xdp_rxq, net, 0, priv->napi.napi_id);
+	if (ret < 0)
+		goto err_napi;
+	ret = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_PAGE_ORDER0,
+					 NULL);
+	if (ret < 0)
+		goto err_rxq;
+#endif
+#ifdef AX_XSK
+	ret = xdp_rxq_info_reg(&priv->xsk_rxq, net, 0, priv->napi.napi_id);
+	if (ret < 0)
+		goto err_rxq;
+	ret = xdp_rxq_info_reg_mem_model(&priv->xsk_rxq,
+					 MEM_TYPE_XSK_BUFF_POOL, NULL);
+	if (ret < 0)
+		goto err_xsk;
+#endif
+
+#ifdef AX_TX_BQL
+	/* Nothing is in flight: close waited for every bulk-out skb */
+	netdev_reset_queue(net);
+#endif
+
+	/* The driver-owned ring replaces usbnet's bulk-in URBs */
+	if (priv->flags & AX_PRIV_FLAG_RX_NAPI)
+		usbnet_pause_rx(dev);
+	else
+		usbnet_resume_rx(dev);
+
+	ret = usbnet_open(net);
+	if (ret < 0)
+		goto err_xsk;
+
+	if (priv->flags & AX_PRIV_FLAG_RX_NAPI)
+		ax88179_rx_ring_start(priv);
+
+	return 0;
+
+err_xsk:
+#ifdef AX_XSK
+	xdp_rxq_info_unreg(&priv->xsk_rxq);
+#endif
+#ifdef AX_XDP
+err_rxq:
+	xdp_rxq_info_unreg(&priv->xdp_rxq);
+err_napi:
+#endif
+	napi_disable(&priv->napi);
+	return ret;
+}
+
+static int ax88179_close(struct net_device *net)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	int ret;
+
+#ifdef AX_TX_AGG
+	ax88179_tx_agg_stop(priv);
+#endif
+	/* usbnet_stop() kills the bulk-in URBs and the rx tasklet, and
+	 * frees every bulk-out skb; each one completes its bytes to BQL, so
+	 * the queue is only reset by the next open
+	 */
+	ret = usbnet_stop(net);
+	ax88179_rx_ring_stop(priv);
+
+	napi_disable(&priv->napi);
+#ifdef AX_XDP
+	/* After napi_disable(), the poll cannot submit new ones */
+	ax88179_xdp_tx_stop(priv);
+#endif
+#ifdef AX_XSK
+	ax88179_xsk_tx_complete(priv);
+	xdp_rxq_info_unreg(&priv->xsk_rxq);
+#endif
+	ax88179_rx_ring_flush(priv);
+	skb_queue_purge(&priv->rx_napi_q);
+#ifdef AX_XDP
+	xdp_rxq_info_unreg(&priv->xdp_rxq);
+#endif
+
+	return ret;
+}
+#endif
+
+#ifdef AX_XDP
+static int ax88179_xdp_setup(struct net_device *net, struct bpf_prog *prog,
+			     struct netlink_ext_ack *extack)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct bpf_prog *old;
+
+	if (prog && !(priv->flags & AX_PRIV_FLAG_RX_NAPI)) {
+		NL_SET_ERR_MSG_MOD(extack, "XDP needs the rx-napi private flag");
+		return -EOPNOTSUPP;
+	}
+
+	if (prog && net->mtu > AX_XDP_MAX_MTU) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EINVAL;
+	}
+
+	old = xchg(&priv->xdp_prog, prog);
+	if (old)
+		bpf_prog_put(old);
+
+	return 0;
+}
+
+#ifdef AX_XSK
+/* Bind or unbind the UMEM of an AF_XDP socket on queue 0 */
+static int ax88179_xsk_setup(struct net_device *net,
+			     struct xsk_buff_pool *pool, u16 qid)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct xsk_buff_pool *old = priv->xsk_pool;
+	bool running = netif_running(net);
+	int ret;
+
+	if (qid != 0)
+		return -EINVAL;
+
+	if (pool) {
+		if (!(priv->flags & AX_PRIV_FLAG_RX_NAPI))
+			return -EOPNOTSUPP;
+		if (old)
+			return -EBUSY;
+
+		/* Only the CPU touches UMEM, but the core wants it mapped */
+		ret = xsk_pool_dma_map(pool, dev->udev->bus->sysdev, 0);
+		if (ret)
+			return ret;
+
+		xsk_pool_set_rxq_info(pool, &priv->xsk_rxq);
+	} else if (!old) {
+		return 0;
+	}
+
+	/* Frames are copied out of UMEM, URBs in flight do not point into it,
+	 * but their descriptors go back to the old socket's completion ring
+	 */
+	if (running)
+		napi_disable(&priv->napi);
+	if (!pool) {
+		ax88179_xdp_tx_stop(priv);
+		ax88179_xsk_tx_complete(priv);
+	}
+	WRITE_ONCE(priv->xsk_pool, pool);
+	if (running)
+		napi_enable(&priv->napi);
+
+	if (!pool)
+		xsk_pool_dma_unmap(old, 0);
+
+	return 0;
+}
+
+static int ax88179_xsk_wakeup(struct net_device *net, u32 qid, u32 flags)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	if (!netif_running(net) || qid != 0 || !READ_ONCE(priv->xsk_pool))
+		return -ENXIO;
+
+	/* TX descriptors are only picked up by the NAPI poll */
+	if (!napi_if_scheduled_mark_missed(&priv->napi)) {
+		local_bh_disable();
+		napi_schedule(&priv->napi);
+		local_bh_enable();
+	}
+
+	return 0;
+}
+#endif
+
+static int ax88179_bpf(struct net_device *net, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return ax88179_xdp_setup(net, bpf->prog, bpf->extack);
+#ifdef AX_XSK
+	case XDP_SETUP_XSK_POOL:
+		return ax88179_xsk_setup(net, bpf->xsk.pool,
+					 bpf->xsk.queue_id);
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+#endif
+
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 29)
+static const struct net_device_ops ax88179_netdev_ops = {
+#ifdef AX_NAPI_RX
+	.ndo_open		= ax88179_open,
+	.ndo_stop		= ax88179_close,
+#else
+	.ndo_open		= usbnet_open,
+	.ndo_stop		= usbnet_stop,
+#endif
+	.ndo_start_xmit		= usbnet_start_xmit,
+	.ndo_tx_timeout		= usbnet_tx_timeout,
+	.ndo_change_mtu		= ax88179_change_mtu,
+	.ndo_do_ioctl		= ax88179_ioctl,
+	.ndo_set_mac_address	= ax88179_set_mac_addr,
+	.ndo_validate_addr	= eth_validate_addr,
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(3, 2, 0)
+	.ndo_set_multicast_list	= ax88179_set_multicast,
+#else
+	.ndo_set_rx_mode	= ax88179_set_multicast,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 39)
+	.ndo_set_features	= ax88179_set_features,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 0, 0)
+	.ndo_features_check	= ax88179_features_check,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+	.ndo_get_stats64	= dev_get_tstats64,
+#endif
+#ifdef AX_XDP
+	.ndo_bpf		= ax88179_bpf,
+#endif
+#ifdef AX_XSK
+	.ndo_xsk_wakeup		= ax88179_xsk_wakeup,
+#endif
+};
+#endif
+
+static int ax88179_check_eeprom(struct usbnet *dev)
+{
+	u8 i = 0;
+	u8 *buf;
+	u8 eeprom[22];
+	u16 csum = 0, delay = HZ / 10;
+	unsigned long jtimeout = 0;
+
 	buf = &eeprom[20];
 
 	/* Read EEPROM content */
 	for (i = 0 ; i < 6; i++) {
 		buf[0] = i;
 		if (ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_SROM_ADDR,
-				      1, 1, buf) < 0) {
-			kfree(eeprom);
+				      1, 1, buf) < 0)
 			return -EINVAL;
-		}
 
 		buf[0] = EEP_RD;
 		if (ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_SROM_CMD,
-				      1, 1, buf) < 0) {
-			kfree(eeprom);
+				      1, 1, buf) < 0)
 			return -EINVAL;
-		}
 
 		jtimeout = jiffies + delay;
 		do {
 			ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_SROM_CMD,
 					 1, 1, buf, 0);
 
-			if (time_after(jiffies, jtimeout)) {
-				kfree(eeprom);
+			if (time_after(jiffies, jtimeout))
 				return -EINVAL;
-			}
 		} while (buf[0] & EEP_BUSY);
 
 		ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_SROM_DATA_LOW,
 				 2, 2, &eeprom[i * 2], 0);
 
-		if ((i == 0) && (eeprom[0] == 0xFF)) {
-			kfree(eeprom);
+		if ((i == 0) && (eeprom[0] == 0xFF))
 			return -EINVAL;
-		}
 	}
 
 	csum = eeprom[6] + eeprom[7] + eeprom[8] + eeprom[9];
 	csum = (csum >> 8) + (csum & 0xff);
 
-	if ((csum + eeprom[10]) == 0xff) {
-		kfree(eeprom);
+	if ((csum + eeprom[10]) == 0xff)
 		return AX_EEP_EFUSE_CORRECT;
-	} else {
-		kfree(eeprom);
+	else
 		return -EINVAL;
-	}
 }
 
 static int ax88179_check_efuse(struct usbnet *dev, void *ledmode)
 {
 	u8	i = 0;	
 	u16	csum = 0;
-	u8	*efuse;
+	u8	efuse[64];
 
-	efuse = kmalloc(64, GFP_KERNEL);
-	if (!efuse)
-		return -ENOMEM;
-
-	if (ax88179_read_cmd(dev, AX_ACCESS_EFUSE, 0, 64, 64, efuse, 0) < 0) {
-		kfree(efuse);
+	if (ax88179_read_cmd(dev, AX_ACCESS_EFUSE, 0, 64, 64, efuse, 0) < 0)
 		return -EINVAL;
-	}
 
-	if (efuse[0] == 0xFF) {
-		kfree(efuse);
+	if (efuse[0] == 0xFF)
 		return -EINVAL;
-	}
 
 	for (i = 0; i < 64; i++)
 		csum = csum + efuse[i];
@@ -1121,10 +2531,8 @@ static int ax88179_check_efuse(struct usbnet *dev, void *ledmode)
 
 	if (csum == 0xFF) {
 		memcpy((u8 *)ledmode, &efuse[51], 2);
-		kfree(efuse);
 		return AX_EEP_EFUSE_CORRECT;
 	} else {
-		kfree(efuse);
 		return -EINVAL;
 	}
 }
@@ -1132,28 +2540,20 @@ static int ax88179_check_efuse(struct usbnet *dev, void *ledmode)
 static int ax88179_convert_old_led(struct usbnet *dev, u8 efuse, void *ledvalue)
 {
 	u8 ledmode = 0;
-	u16 *tmp16;
+	u16 tmp16;
 	u16 led = 0;
 
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
-
 	/* loaded the old eFuse LED Mode */
 	if (efuse) {
 		if (ax88179_read_cmd(dev, AX_ACCESS_EFUSE, 0x18,
-				     1, 2, tmp16, 1) < 0) {
-			kfree(tmp16);
+				     1, 2, &tmp16, 1) < 0)
 			return -EINVAL;
-	}
-		ledmode = (u8)(*tmp16 & 0xFF);
+		ledmode = (u8)(tmp16 & 0xFF);
 	} else { /* loaded the old EEprom LED Mode */
 		if (ax88179_read_cmd(dev, AX_ACCESS_EEPROM, 0x3C,
-				     1, 2, tmp16, 1) < 0) {
-			kfree(tmp16);
+				     1, 2, &tmp16, 1) < 0)
 			return -EINVAL;
-		}
-		ledmode = (u8) (*tmp16 >> 8);
+		ledmode = (u8) (tmp16 >> 8);
 	}
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 	netdev_dbg(dev->net, "Old LED Mode = %02X\n", ledmode);
@@ -1185,7 +2585,6 @@ static int ax88179_convert_old_led(struct usbnet *dev, u8 efuse, void *ledvalue)
 	}
 
 	memcpy((u8 *)ledvalue, &led, 2);
-	kfree(tmp16);
 
 	return 0;
 }
@@ -1198,11 +2597,10 @@ static int ax88179_led_setting(struct usbnet *dev)
 	u16 *tmp16;	
 	u8 *value;
 	u8 *tmp;
+	u16 buf[3];
 	unsigned long jtimeout = 0;
 
-	tmp = kmalloc(6, GFP_KERNEL);
-	if (!tmp)
-		return -ENOMEM;
+	tmp = (u8 *)buf;
 
 	value = (u8*)tmp;
 	tmp16 = (u16*)tmp;
@@ -1217,27 +2615,21 @@ static int ax88179_led_setting(struct usbnet *dev)
 		*value = AX_GPIO_CTRL_GPIO3EN | AX_GPIO_CTRL_GPIO2EN |
 			AX_GPIO_CTRL_GPIO1EN;
 		if (ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_GPIO_CTRL,
-				      1, 1, value) < 0) {
-			kfree(tmp);
+				      1, 1, value) < 0)
 			return -EINVAL;
-		}
 	}
 
 	/* check EEprom */
 	if (ax88179_check_eeprom(dev) == AX_EEP_EFUSE_CORRECT) {
 		*value = 0x42;
 		if (ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_SROM_ADDR,
-				      1, 1, value) < 0) {
-			kfree(tmp);
+				      1, 1, value) < 0)
 			return -EINVAL;
-		}
 
 		*value = EEP_RD;
 		if (ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_SROM_CMD,
-				      1, 1, value) < 0) {
-			kfree(tmp);
+				      1, 1, value) < 0)
 			return -EINVAL;
-		}
 
 		jtimeout = jiffies + delay;
 		do {
@@ -1345,14 +2737,14 @@ static int ax88179_led_setting(struct usbnet *dev)
 
 	ax88179_write_cmd(dev, AX_ACCESS_MAC, 0x73, 1, 1, tmp16);
 
-	kfree(tmp);
 
 	return 0;
 }
 
 static int ax88179_AutoDetach(struct usbnet *dev, int in_pm)
 {
-	u16 *tmp16;
+	u16 buf[3];
+	u16 *tmp16 = buf;
 	u8 *tmp8;
 	int (*fnr)(struct usbnet *, u8, u16, u16, u16, void *, int);
 	int (*fnw)(struct usbnet *, u8, u16, u16, u16, void *);	
@@ -1365,21 +2757,13 @@ static int ax88179_AutoDetach(struct usbnet *dev, int in_pm)
 		fnw = ax88179_write_cmd_nopm;
 	}
 
-	tmp16 = kmalloc(3, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
-
 	tmp8 = (u8*)(&tmp16[2]);
 
-	if (fnr(dev, AX_ACCESS_EEPROM, 0x43, 1, 2, tmp16, 1) < 0) {
-		kfree(tmp16);
+	if (fnr(dev, AX_ACCESS_EEPROM, 0x43, 1, 2, tmp16, 1) < 0)
 		return 0;
-	}
 
-	if ((*tmp16 == 0xFFFF) || (!(*tmp16 & 0x0100))) {
-		kfree(tmp16);
+	if ((*tmp16 == 0xFFFF) || (!(*tmp16 & 0x0100)))
 		return 0;
-	}
 
 	/* Enable Auto Detach bit */	
 	*tmp8 = 0;
@@ -1391,7 +2775,6 @@ static int ax88179_AutoDetach(struct usbnet *dev, int in_pm)
 	*tmp16 |= AX_PHYPWR_RSTCTL_AUTODETACH;
 	fnw(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, tmp16);
 
-	kfree(tmp16);
 
 	return 0;
 }
@@ -1400,16 +2783,13 @@ static int access_eeprom_mac(struct usbnet *dev, u8 *buf, u8 offset, int wflag)
 {
 	int ret = 0, i;
 	u16* tmp = (u16*)buf;
-	u16* tmp16;
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
+	u16 tmp16;
 
 	for (i = 0; i < (ETH_ALEN >> 1); i++) {
 		if (wflag) {			
-			*tmp16 = cpu_to_le16(*(tmp + i));
+			tmp16 = cpu_to_le16(*(tmp + i));
 			ret = ax88179_write_cmd(dev, AX_ACCESS_EEPROM,
-						offset + i, 1, 2, tmp16);
+						offset + i, 1, 2, &tmp16);
 			if (ret < 0)
 				break;
 
@@ -1430,7 +2810,6 @@ static int access_eeprom_mac(struct usbnet *dev, u8 *buf, u8 offset, int wflag)
 			#else
 				devdbg(dev, "Failed to read MAC address from EEPROM: %d\n", ret);
 			#endif
-			kfree(tmp16);
 			return ret;
 		}
 		memcpy(dev->net->dev_addr, buf, ETH_ALEN);
@@ -1438,13 +2817,10 @@ static int access_eeprom_mac(struct usbnet *dev, u8 *buf, u8 offset, int wflag)
 	else {
 		/* reload eeprom data */
 		ret = ax88179_write_cmd(dev, AX_RELOAD_EEPROM_EFUSE, 0, 0, 0, 0);
-		if (ret < 0) {
-			kfree(tmp16);
+		if (ret < 0)
 			return ret;
-		}
 	}
 
-	kfree(tmp16);
 	return 0;
 }
 
@@ -1548,13 +2924,76 @@ out:
 	return ret;
 }
 
+static void ax88179_free_priv(struct usbnet *dev)
+{
+	struct ax88179_data *ax179_data = (struct ax88179_data *)dev->data;
+	struct ax88179_priv *priv = ax179_data->priv;
+	int i;
+
+	if (!priv)
+		return;
+
+#ifdef AX_LINK_WORK
+	ax88179_link_stop(priv);
+#endif
+#ifdef AX_PHY_CACHE
+	ax88179_phy_stop(priv);
+#endif
+	for (i = 0; i < AX_ASYNC_SLOTS; i++) {
+		usb_kill_urb(priv->async[i].urb);
+		usb_free_urb(priv->async[i].urb);
+	}
+
+#ifdef AX_RX_DIM
+	cancel_work_sync(&priv->rx_dim.work);
+#endif
+#ifdef AX_TX_AGG
+	ax88179_tx_agg_stop(priv);
+#endif
+#ifdef AX_TX_BOUNCE
+	/* A slot still in flight goes with the skb built on it */
+	for (i = 0; i < AX_TX_BOUNCE_SLOTS; i++)
+		if (priv->tx_bounce[i])
+			put_page(priv->tx_bounce[i]);
+#endif
+#ifdef AX_NAPI_RX
+	ax88179_rx_ring_stop(priv);
+	netif_napi_del(&priv->napi);
+	skb_queue_purge(&priv->rx_napi_q);
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++) {
+		ax88179_rx_page_free(priv, &priv->rx_ring[i]);
+		usb_free_urb(priv->rx_ring[i].urb);
+	}
+	ax88179_rx_pool_destroy(priv);
+#endif
+#ifdef AX_XDP
+	for (i = 0; i < AX_XDP_TX_URBS; i++) {
+		usb_kill_urb(priv->xdp_tx[i].urb);
+		usb_free_urb(priv->xdp_tx[i].urb);
+		kfree(priv->xdp_tx[i].buf);
+	}
+	kfree(priv->xdp_rx_buf);
+	if (priv->xdp_prog)
+		bpf_prog_put(priv->xdp_prog);
+#endif
+	kfree(priv->io_buf);
+	kfree(priv);
+	ax179_data->priv = NULL;
+}
+
 static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 {
 	struct ax88179_data *ax179_data = (struct ax88179_data *)dev->data;
+	struct ax88179_seq *seq = NULL;
+	struct ax88179_priv *priv;
 	u32 tmp32;
 	u16 tmp16;
 	u8 tmp, mac[6];
-	int ret;
+	ktime_t start, t;
+	int ret, i;
+
+	start = t = ktime_get();
 
 	usbnet_get_endpoints(dev, intf);
 
@@ -1563,25 +3002,171 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 
 	memset(ax179_data, 0, sizeof(*ax179_data));
 
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+	priv->dev = dev;
+	spin_lock_init(&priv->reg_lock);
+	spin_lock_init(&priv->async_lock);
+	mutex_init(&priv->io_lock);
+	mutex_init(&priv->bulkin_lock);
+#ifdef AX_LINK_WORK
+	INIT_DELAYED_WORK(&priv->link_work, ax88179_link_work);
+#endif
+#ifdef AX_PHY_CACHE
+	INIT_DELAYED_WORK(&priv->phy_work, ax88179_phy_work);
+#endif
+	/* free_priv() stops all of these, even if bind fails below */
+#ifdef AX_RX_DIM
+	INIT_WORK(&priv->rx_dim.work, ax88179_dim_work);
+#endif
+#ifdef AX_TX_AGG
+	skb_queue_head_init(&priv->tx_agg_q);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 15, 0)
+	hrtimer_setup(&priv->tx_agg_timer, ax88179_tx_agg_timer,
+		      CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&priv->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	priv->tx_agg_timer.function = ax88179_tx_agg_timer;
+#endif
+	tasklet_setup(&priv->tx_agg_bh, ax88179_tx_agg_bh);
+#endif
+#ifdef AX_NAPI_RX
+	skb_queue_head_init(&priv->rx_napi_q);
+	INIT_LIST_HEAD(&priv->rx_done);
+	spin_lock_init(&priv->rx_lock);
+	INIT_DELAYED_WORK(&priv->rx_refill, ax88179_rx_refill_work);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+	netif_napi_add(dev->net, &priv->napi, ax88179_napi_poll);
+#else
+	netif_napi_add(dev->net, &priv->napi, ax88179_napi_poll,
+		       NAPI_POLL_WEIGHT);
+#endif
+#endif
+#ifdef AX_XDP
+	init_usb_anchor(&priv->xdp_tx_anchor);
+#endif
+	ax179_data->priv = priv;
+
+	priv->io_buf = kmalloc(AX_IO_BUF_LEN, GFP_KERNEL);
+	if (!priv->io_buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < AX_ASYNC_SLOTS; i++) {
+		priv->async[i].priv = priv;
+		priv->async[i].urb = usb_alloc_urb(0, GFP_KERNEL);
+		if (!priv->async[i].urb) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+#ifdef AX_TX_BOUNCE
+	for (i = 0; i < AX_TX_BOUNCE_SLOTS; i++) {
+		priv->tx_bounce[i] = alloc_pages(GFP_KERNEL | __GFP_COMP,
+						 AX_TX_BOUNCE_ORDER);
+		if (!priv->tx_bounce[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+#endif
+
+	if (rx_copybreak < 0)
+		priv->rx_copybreak = AX_RX_COPYBREAK_DEFAULT;
+	else if (rx_copybreak > AX_RX_COPYBREAK_MAX)
+		priv->rx_copybreak = AX_RX_COPYBREAK_MAX;
+	else
+		priv->rx_copybreak = rx_copybreak;
+#ifdef AX_RX_HASH
+	priv->rx_hash_seed = get_random_u32();
+#endif
+
+	/* bsize/ifg are the defaults of every adapter */
+	priv->rx_coal_usecs = -1;
+	priv->rx_coal_size = min(bsize, AX_BULKIN_SIZE_MAX);
+	priv->rx_coal_ifg = min(ifg, AX_BULKIN_IFG_MAX);
+
+	/* adaptive-rx stays off until "ethtool -C ethX adaptive-rx on" */
+	priv->rx_dim_profile = AX_DIM_DEFAULT_PROFILE;
+#ifdef AX_RX_DIM
+	priv->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	priv->rx_dim.profile_ix = AX_DIM_DEFAULT_PROFILE;
+#endif
+
+	/* tx-aggregation, tx-xmit-more and tx-prio are opt-in */
+#ifdef AX_NAPI_RX
+	priv->flags |= AX_PRIV_FLAG_RX_NAPI;
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++) {
+		priv->rx_ring[i].priv = priv;
+		priv->rx_ring[i].urb = usb_alloc_urb(0, GFP_KERNEL);
+		if (!priv->rx_ring[i].urb) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		/* The ring is poisoned whenever it is not running */
+		usb_poison_urb(priv->rx_ring[i].urb);
+	}
+	ax88179_rx_ring_init(priv);
+	ax88179_rx_pool_create(priv);
+#endif
+#if defined(AX_XDP) && LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	/* No XSK_ZEROCOPY: bulk transfers carry many frames, so every AF_XDP
+	 * frame is copied and sockets are bound in copy mode
+	 */
+	dev->net->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT;
+#endif
+#ifdef AX_XDP
+	priv->xdp_rx_buf = kmalloc(AX_XDP_RX_BUF_SIZE, GFP_KERNEL);
+	if (!priv->xdp_rx_buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < AX_XDP_TX_URBS; i++) {
+		struct ax88179_xdp_tx *tx = &priv->xdp_tx[i];
+
+		tx->priv = priv;
+		tx->urb = usb_alloc_urb(0, GFP_KERNEL);
+		tx->buf = kmalloc(AX_XDP_TX_BUF_SIZE, GFP_KERNEL);
+		if (!tx->urb || !tx->buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+#endif
+
+	/* Only the settling delays below wait between commands */
+	seq = ax88179_seq_alloc(dev);
+	if (!seq) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	tmp32 = 0;
-	ax88179_write_cmd(dev, 0x81, 0x310, 0, 4, &tmp32);
+	ax88179_seq_write(seq, 0x81, 0x310, 0, 4, &tmp32);
 
 	/* Power up ethernet PHY */
 	tmp16 = 0;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, &tmp16);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, &tmp16);
 	tmp16 = AX_PHYPWR_RSTCTL_IPRL;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, &tmp16);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, &tmp16);
+	ax88179_seq_run(seq);
 	msleep(200);
+	ax88179_step_time(dev, "PHY power-up", &t);
 
 	tmp = AX_CLK_SELECT_ACS | AX_CLK_SELECT_BCS;
 	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_CLK_SELECT, 1, 1, &tmp);
 	msleep(100);
+	ax88179_step_time(dev, "clock select", &t);
 
 	/* Get the MAC address */
 	memset(mac, 0, ETH_ALEN);
 	ret = ax88179_get_mac(dev, mac);
 	if (ret)
 		goto out;
+	ax88179_step_time(dev, "MAC address", &t);
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 		netdev_dbg(dev->net, "MAC [%02x-%02x-%02x-%02x-%02x-%02x]\n",
@@ -1596,20 +3181,17 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 #endif
 
 	/* RX bulk configuration, default for USB3.0 to Giga*/
-	memcpy(mac, &AX88179_BULKIN_SIZE[0], 5);
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_BULKIN_QCTRL, 5, 5, mac);
-
-	dev->rx_urb_size = 1024 * 20;
+	ax88179_bulkin_update(dev, 0);
 
 	tmp = 0x34;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW, 1, 1, &tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW, 1, 1, &tmp);
 
 	tmp = 0x52;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
 			  1, 1, &tmp);
 
 	/* Disable auto-power-OFF GigaPHY after ethx down*/
-	ax88179_write_cmd(dev, 0x91, 0, 0, 0, NULL);
+	ax88179_seq_write(seq, 0x91, 0, 0, 0, NULL);
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 30)
 	dev->net->do_ioctl = ax88179_ioctl;
@@ -1647,23 +3229,45 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
 	if (usb_device_no_sg_constraint(dev->udev))
 		dev->can_dma_sg = 1;
-	dev->net->features |= NETIF_F_SG | NETIF_F_TSO;
+	dev->net->features |= NETIF_F_SG | NETIF_F_TSO | NETIF_F_TSO6;
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 39)
 	dev->net->hw_features |= NETIF_F_IP_CSUM;
 	dev->net->hw_features |= NETIF_F_IPV6_CSUM;
-	dev->net->hw_features |= NETIF_F_SG | NETIF_F_TSO;
+	dev->net->hw_features |= NETIF_F_SG | NETIF_F_TSO | NETIF_F_TSO6;
+#endif
+
+#ifdef AX_RX_HASH
+	dev->net->features |= NETIF_F_RXHASH;
+	dev->net->hw_features |= NETIF_F_RXHASH;
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 26)
+	/* 802.1Q tags stay in the frame and the adapter's checksum offload
+	 * and TSO of tagged frames are untested, so VLAN devices only get SG
+	 */
+	dev->net->vlan_features |= NETIF_F_SG;
+#endif
+
+	/* Largest super-frame the bulk-out engine segments, as TCP sizes it */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+	netif_set_tso_max_size(dev->net, AX_GSO_MAX_SIZE);
+	netif_set_tso_max_segs(dev->net, AX_TSO_MAX_SEGS);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 26)
+	netif_set_gso_max_size(dev->net, AX_GSO_MAX_SIZE);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 5, 0)
+	dev->net->gso_max_segs = AX_TSO_MAX_SEGS;
+#endif
 #endif
 
 	/* Enable checksum offload */
 	tmp = AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
 	      AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &tmp);
 
 	tmp = AX_TXCOE_IP | AX_TXCOE_TCP | AX_TXCOE_UDP |
 	      AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &tmp);
 
 	ax179_data->checksum |= AX_RX_CHECKSUM | AX_TX_CHECKSUM;
 
@@ -1672,27 +3276,33 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 		 AX_RX_CTL_AMALL | AX_RX_CTL_AB;
 	if (NET_IP_ALIGN == 0)
 		tmp16 |= AX_RX_CTL_IPE;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
 
 	tmp = AX_MONITOR_MODE_PMETYPE | AX_MONITOR_MODE_PMEPOL |
 	      AX_MONITOR_MODE_RWMP;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp);
+
+	ax88179_seq_read(seq, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp, 0);
 
-	ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, &tmp, 0);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_dbg(dev->net, "Monitor mode = 0x%02x\n", tmp);
-#else
-		devdbg(dev, "Monitor mode = 0x%02x\n", tmp);
-#endif
 	/* Configure default medium type => giga */
 	tmp16 = AX_MEDIUM_RECEIVE_EN	 | AX_MEDIUM_TXFLOW_CTRLEN |
 		AX_MEDIUM_RXFLOW_CTRLEN | AX_MEDIUM_FULL_DUPLEX   |
 		AX_MEDIUM_GIGAMODE;
 
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
 			  2, 2, &tmp16);
 
+	ax88179_seq_run(seq);
+	kfree(seq);
+	ax88179_step_time(dev, "MAC setup", &t);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+		netdev_dbg(dev->net, "Monitor mode = 0x%02x\n", tmp);
+#else
+		devdbg(dev, "Monitor mode = 0x%02x\n", tmp);
+#endif
+
 	ax88179_led_setting(dev);
+	ax88179_step_time(dev, "LED setup", &t);
 
 	ax88179_EEE_setting(dev);
 
@@ -1703,9 +3313,14 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 
 	/* Restart autoneg */
 	mii_nway_restart(&dev->mii);
+	ax88179_step_time(dev, "PHY setup", &t);
 
 	netif_carrier_off(dev->net);
 
+	/* The first open finds the PHY set up as above */
+	priv->hw_ready = 1;
+	ax88179_step_time(dev, "bind total", &start);
+
 	printk(version);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 		netdev_info(dev->net, "mtu %d\n", dev->net->mtu);
@@ -1715,19 +3330,19 @@ static int ax88179_bind(struct usbnet *dev, struct usb_interface *intf)
 	return 0;
 
 out:
+	kfree(seq);
+	ax88179_free_priv(dev);
 	return ret;
 
 }
 
 static void ax88179_unbind(struct usbnet *dev, struct usb_interface *intf)
 {
-	u16 *tmp16;
+	u16 buf[3];
+	u16 *tmp16 = buf;
 	u8 *tmp8;
 	struct ax88179_data *ax179_data = (struct ax88179_data *) dev->data;
 
-	tmp16 = kmalloc(3, GFP_KERNEL);
-	if (!tmp16)
-		return;
 	tmp8 = (u8*)(&tmp16[2]);
 
 	if (ax179_data) {
@@ -1746,7 +3361,7 @@ static void ax88179_unbind(struct usbnet *dev, struct usb_interface *intf)
 		msleep(200);
 	}
 
-	kfree(tmp16);
+	ax88179_free_priv(dev);
 }
 
 static void
@@ -1765,52 +3380,1300 @@ ax88179_rx_checksum(struct sk_buff *skb, u32 *pkt_hdr)
 		skb->ip_summed = CHECKSUM_UNNECESSARY;
 }
 
-static int ax88179_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
+#ifdef AX_RX_HASH
+/* L4 flow hash over the headers the hardware already classified, so RPS
+ * and RFS need not dissect the frame again.  skb->data is the MAC header.
+ */
+static void ax88179_rx_hash(struct ax88179_priv *priv, struct sk_buff *skb,
+			    u32 pkt_hdr)
 {
-	struct sk_buff *ax_skb = NULL;
-	int pkt_cnt = 0;
-	u32 rx_hdr = 0;
-	u16 hdr_off = 0;
-	u32 *pkt_hdr = NULL;
+	u32 l3 = (pkt_hdr & AX_RXHDR_L3_TYPE_MASK) >> AX_RXHDR_L3_TYPE_SHIFT;
+	u32 l4 = pkt_hdr & AX_RXHDR_L4_TYPE_MASK;
+	unsigned int hlen = skb_headlen(skb);
+	unsigned int off = ETH_HLEN;
+	const struct ipv6hdr *ip6h;
+	const struct iphdr *iph;
+	u32 ports, hash;
+
+	if (!(priv->dev->net->features & NETIF_F_RXHASH) ||
+	    (l4 != AX_RXHDR_L4_TYPE_TCP && l4 != AX_RXHDR_L4_TYPE_UDP) ||
+	    hlen < ETH_HLEN)
+		return;
 
-	if (skb->len == 0) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_err(dev->net, "RX SKB length zero");
-#else
-		deverr(dev, "RX SKB length zero");
-#endif
-		dev->net->stats.rx_errors++;
-		return 0;
+	if (((struct ethhdr *)skb->data)->h_proto == htons(ETH_P_8021Q))
+		off += VLAN_HLEN;
+
+	switch (l3) {
+	case AX_RXHDR_L3_TYPE_IP:
+		if (hlen < off + sizeof(*iph))
+			return;
+		iph = (const struct iphdr *)(skb->data + off);
+		if (ip_is_fragment(iph))
+			return;
+		off += iph->ihl * 4;
+		if (hlen < off + sizeof(ports))
+			return;
+		memcpy(&ports, skb->data + off, sizeof(ports));
+		hash = jhash_3words((__force u32)iph->saddr,
+				    (__force u32)iph->daddr, ports,
+				    priv->rx_hash_seed);
+		break;
+	case AX_RXHDR_L3_TYPE_IPV6:
+		if (hlen < off + sizeof(*ip6h) + sizeof(ports))
+			return;
+		ip6h = (const struct ipv6hdr *)(skb->data + off);
+		if (ip6h->nexthdr != IPPROTO_TCP &&
+		    ip6h->nexthdr != IPPROTO_UDP)
+			return;
+		memcpy(&ports, skb->data + off + sizeof(*ip6h), sizeof(ports));
+		hash = jhash_3words(ipv6_addr_hash(&ip6h->saddr),
+				    ipv6_addr_hash(&ip6h->daddr), ports,
+				    priv->rx_hash_seed);
+		break;
+	default:
+		return;
 	}
 
-	skb_trim(skb, skb->len - 4);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 22)
-	memcpy(&rx_hdr, skb_tail_pointer(skb), sizeof(rx_hdr));
-#else
-	memcpy(&rx_hdr, skb->tail, sizeof(rx_hdr));
+	skb_set_hash(skb, hash, PKT_HASH_TYPE_L4);
+}
 #endif
+
+/* Checksum, flow hash and 802.1p priority from the per-packet header */
+static void
+ax88179_rx_meta(struct ax88179_priv *priv, struct sk_buff *skb, u32 pkt_hdr)
+{
+	ax88179_rx_checksum(skb, &pkt_hdr);
+
+	if (pkt_hdr & AX_RXHDR_VLAN_IND_MASK)
+		skb->priority = (pkt_hdr & AX_RXHDR_PRI_MASK) >>
+				AX_RXHDR_PRI_SHIFT;
+#ifdef AX_RX_HASH
+	ax88179_rx_hash(priv, skb, pkt_hdr);
+#endif
+}
+
+/* Address of len bytes at off, NULL if they cross a ring page */
+static const u8 *ax88179_rx_src_ptr(const struct ax88179_rx_src *src, u32 off,
+				    u32 len)
+{
+	u32 mask = (1U << src->shift) - 1;
+
+	if (src->data)
+		return src->data + off;
+	if ((off >> src->shift) != ((off + len - 1) >> src->shift))
+		return NULL;
+
+	return (u8 *)page_address(src->pages[off >> src->shift]) + (off & mask);
+}
+
+static void ax88179_rx_src_copy(const struct ax88179_rx_src *src, u32 off,
+				void *to, u32 len)
+{
+	u32 mask = (1U << src->shift) - 1;
+	u8 *dst = to;
+	u32 n;
+
+	if (src->data) {
+		memcpy(dst, src->data + off, len);
+		return;
+	}
+
+	while (len) {
+		n = min(len, mask + 1 - (off & mask));
+		memcpy(dst, (u8 *)page_address(src->pages[off >> src->shift]) +
+		       (off & mask), n);
+		dst += n;
+		off += n;
+		len -= n;
+	}
+}
+
+/* Parse the bulk-in trailer and set up the frame cursor */
+static int ax88179_rx_agg_init(struct usbnet *dev,
+			       const struct ax88179_rx_src *src, u32 len,
+			       struct ax88179_rx_agg *agg)
+{
+	u32 rx_hdr = 0;
+
+	if (len < sizeof(rx_hdr))
+		return 0;
+
+	agg->len = len - sizeof(rx_hdr);
+	ax88179_rx_src_copy(src, agg->len, &rx_hdr, sizeof(rx_hdr));
 	le32_to_cpus(&rx_hdr);
 
-	pkt_cnt = (u16)rx_hdr;
-	hdr_off = (u16)(rx_hdr >> 16);
-	pkt_hdr = (u32 *)(skb->data + hdr_off);
+	agg->pkt_cnt = (u16)rx_hdr;
+	agg->hdr_off = (u16)(rx_hdr >> 16);
+	agg->pkt_off = 0;
+	agg->parsed = 1;
 
+	if (agg->hdr_off + agg->pkt_cnt * sizeof(u32) > agg->len) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+		netdev_err(dev->net, "RX header out of range");
+#else
+		deverr(dev, "RX header out of range");
+#endif
+		agg->pkt_cnt = 0;
+		return 0;
+	}
 
-	while (pkt_cnt--) {
-		u16 pkt_len;
+	return 1;
+}
+
+/* Step to the next good frame of the transfer, 0 when none is left */
+static int ax88179_rx_agg_next(const struct ax88179_rx_src *src,
+			       struct ax88179_rx_agg *agg, u32 *pkt_off,
+			       u16 *pkt_len, u32 *pkt_hdr)
+{
+	while (agg->pkt_cnt) {
+		u32 hdr = 0;
+		u32 off = agg->pkt_off;
+		u16 len;
+
+		ax88179_rx_src_copy(src, agg->hdr_off, &hdr, sizeof(hdr));
+		le32_to_cpus(&hdr);
+		len = (hdr >> 16) & 0x1fff;
 
-		le32_to_cpus(pkt_hdr);
-		pkt_len = (*pkt_hdr >> 16) & 0x1fff;
+		agg->pkt_cnt--;
+		agg->hdr_off += sizeof(hdr);
+		agg->pkt_off += (len + 7) & 0xFFF8;
 
 		/* Check CRC or runt packet */
-		if ((*pkt_hdr & AX_RXHDR_CRC_ERR) ||
-		    (*pkt_hdr & AX_RXHDR_DROP_ERR)) {
-			skb_pull(skb, (pkt_len + 7) & 0xFFF8);
-			pkt_hdr++;
+		if ((hdr & AX_RXHDR_CRC_ERR) || (hdr & AX_RXHDR_DROP_ERR))
+			continue;
+
+		if (off + len > agg->len) {
+			agg->pkt_cnt = 0;
+			break;
+		}
+
+		*pkt_off = off;
+		*pkt_len = len;
+		*pkt_hdr = hdr;
+		return 1;
+	}
+
+	return 0;
+}
+
+static struct sk_buff *
+ax88179_rx_build(struct usbnet *dev, struct sk_buff *skb, u32 pkt_off,
+		 u16 pkt_len, u32 pkt_hdr)
+{
+	struct sk_buff *ax_skb = NULL;
+
+	if (pkt_len <= ax88179_get_priv(dev)->rx_copybreak) {
+		/* Right-sized copy, the bulk-in buffer is not held up */
+		ax_skb = alloc_skb(pkt_len + NET_IP_ALIGN, GFP_ATOMIC);
+		if (!ax_skb)
+			return NULL;
+		skb_reserve(ax_skb, NET_IP_ALIGN);
+
+		skb_put(ax_skb, pkt_len);
+		memcpy(ax_skb->data, skb->data + pkt_off, pkt_len);
+
+		if (NET_IP_ALIGN == 0)
+			skb_pull(ax_skb, 2);
+	} else {
+		ax_skb = skb_clone(skb, GFP_ATOMIC);
+		if (!ax_skb)
+			return NULL;
+
+		skb_pull(ax_skb, pkt_off);
+		ax_skb->len = pkt_len;
+
+		/* Skip IP alignment psudo header */
+		if (NET_IP_ALIGN == 0)
+			skb_pull(ax_skb, 2);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 22)
+		ax_skb->tail = ax_skb->data + ax_skb->len;
+#else
+		skb_set_tail_pointer(ax_skb, ax_skb->len);
+#endif
+	}
+
+	ax88179_rx_meta(ax88179_get_priv(dev), ax_skb, pkt_hdr);
+
+	return ax_skb;
+}
+
+#ifdef AX_NAPI_RX
+static void ax88179_napi_deliver(struct ax88179_priv *priv,
+				 struct sk_buff *skb)
+{
+	struct net_device *net = priv->dev->net;
+
+	skb->protocol = eth_type_trans(skb, net);
+	dev_sw_netstats_rx_add(net, skb->len);
+	napi_gro_receive(&priv->napi, skb);
+}
+
+static int ax88179_rx_page_alloc(struct ax88179_priv *priv,
+				 struct ax88179_rx_buf *buf, int i, gfp_t gfp)
+{
+#ifdef AX_RX_PAGE_POOL
+	if (priv->rx_pool) {
+		buf->page[i] = page_pool_alloc_pages(priv->rx_pool,
+						     gfp | __GFP_NOWARN);
+		if (!buf->page[i])
+			return -ENOMEM;
+
+		/* Frames take references without touching the atomic */
+		page_pool_fragment_page(buf->page[i], AX_RX_PP_BIAS);
+		buf->pp_bias[i] = AX_RX_PP_BIAS;
+		return 0;
+	}
+#endif
+	buf->page[i] = alloc_pages(gfp | __GFP_COMP | __GFP_NOWARN,
+				   priv->rx_seg_shift - PAGE_SHIFT);
+
+	return buf->page[i] ? 0 : -ENOMEM;
+}
+
+/* A frame is about to reference a ring page */
+static void ax88179_rx_page_ref(struct ax88179_priv *priv,
+				struct ax88179_rx_buf *buf, int i,
+				struct sk_buff *skb)
+{
+#ifdef AX_RX_PAGE_POOL
+	if (priv->rx_pool) {
+		buf->pp_bias[i]--;
+		skb_mark_for_recycle(skb);
+		return;
+	}
+#endif
+	get_page(buf->page[i]);
+}
+
+/* Keep the page for the next transfer if the stack holds no frames of it,
+ * otherwise drop our share; the last frame freed returns it to the pool.
+ */
+static bool ax88179_rx_page_reuse(struct ax88179_priv *priv,
+				  struct ax88179_rx_buf *buf, int i)
+{
+	struct page *page = buf->page[i];
+
+#ifdef AX_RX_PAGE_POOL
+	if (priv->rx_pool) {
+		if (page_pool_unref_page(page, buf->pp_bias[i]))
+			return false;
+
+		page_pool_fragment_page(page, AX_RX_PP_BIAS);
+		buf->pp_bias[i] = AX_RX_PP_BIAS;
+		dma_sync_single_for_device(priv->dma_dev,
+					   page_pool_get_dma_addr(page),
+					   1U << priv->rx_seg_shift,
+					   DMA_FROM_DEVICE);
+		return true;
+	}
+#endif
+	if (page_ref_count(page) == 1)
+		return true;
+
+	put_page(page);
+	return false;
+}
+
+static void ax88179_rx_page_free(struct ax88179_priv *priv,
+				 struct ax88179_rx_buf *buf)
+{
+	int i;
+
+	for (i = 0; i < priv->rx_segs; i++) {
+		struct page *page = buf->page[i];
+
+		if (!page)
+			continue;
+		buf->page[i] = NULL;
+#ifdef AX_RX_PAGE_POOL
+		if (priv->rx_pool) {
+			if (buf->pp_bias[i] > 1)
+				page_pool_unref_page(page,
+						     buf->pp_bias[i] - 1);
+			page_pool_put_full_page(priv->rx_pool, page, false);
+			continue;
+		}
+#endif
+		put_page(page);
+	}
+}
+
+/* The pool maps pages once for the HCD; without DMA plain pages are used */
+static void ax88179_rx_pool_create(struct ax88179_priv *priv)
+{
+#ifdef AX_RX_PAGE_POOL
+	struct usb_device *udev = priv->dev->udev;
+	struct page_pool_params pp = { 0 };
+	struct page_pool *pool;
+
+	if (!hcd_uses_dma(bus_to_hcd(udev->bus)))
+		return;
+
+	pp.order = priv->rx_seg_shift - PAGE_SHIFT;
+	pp.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+	pp.pool_size = AX_RX_RING_SIZE * priv->rx_segs * 2;
+	pp.nid = dev_to_node(udev->bus->sysdev);
+	pp.dev = udev->bus->sysdev;
+	pp.dma_dir = DMA_FROM_DEVICE;
+	pp.max_len = 1U << priv->rx_seg_shift;
+
+	pool = page_pool_create(&pp);
+	if (IS_ERR(pool)) {
+		netdev_warn(priv->dev->net, "page_pool failed: %ld\n",
+			    PTR_ERR(pool));
+		return;
+	}
+
+	priv->rx_pool = pool;
+	priv->dma_dev = udev->bus->sysdev;
+#endif
+}
+
+static void ax88179_rx_pool_destroy(struct ax88179_priv *priv)
+{
+#ifdef AX_RX_PAGE_POOL
+	/* Pages still held by the stack keep the pool alive */
+	if (priv->rx_pool)
+		page_pool_destroy(priv->rx_pool);
+	priv->rx_pool = NULL;
+#endif
+}
+
+/* Order-0 ring pages when the HCD takes page lists, otherwise one page
+ * for the whole transfer
+ */
+static void ax88179_rx_ring_init(struct ax88179_priv *priv)
+{
+	if (AX_RX_BUF_PAGES > 1 &&
+	    priv->dev->udev->bus->sg_tablesize >= AX_RX_BUF_PAGES) {
+		priv->rx_seg_shift = PAGE_SHIFT;
+		priv->rx_segs = AX_RX_BUF_PAGES;
+	} else {
+		priv->rx_seg_shift = PAGE_SHIFT + get_order(AX_RX_BUF_SIZE);
+		priv->rx_segs = 1;
+	}
+}
+
+/* The pool's pages are mapped for good, the CPU needs its own view */
+static void ax88179_rx_buf_sync(struct ax88179_priv *priv,
+				struct ax88179_rx_buf *buf)
+{
+#ifdef AX_RX_PAGE_POOL
+	u32 seg = 1U << priv->rx_seg_shift;
+	u32 len = buf->urb->actual_length;
+	int i;
+
+	if (!priv->rx_pool)
+		return;
+
+	for (i = 0; i * seg < len; i++)
+		dma_sync_single_for_cpu(priv->dma_dev,
+					page_pool_get_dma_addr(buf->page[i]),
+					min(seg, len - i * seg),
+					DMA_FROM_DEVICE);
+#endif
+}
+
+static void ax88179_rx_ring_src(struct ax88179_priv *priv,
+				struct ax88179_rx_buf *buf,
+				struct ax88179_rx_src *src)
+{
+	src->data = NULL;
+	src->pages = buf->page;
+	src->shift = priv->rx_seg_shift;
+}
+
+/* Copy the headers into a small skb and attach the rest of the frame as
+ * fragments of the ring pages it spans, each accounted as a whole page.
+ * Frames up to the copybreak are copied whole so that they never pin a
+ * ring page in a socket queue.
+ */
+static struct sk_buff *
+ax88179_rx_build_frag(struct ax88179_priv *priv, struct ax88179_rx_buf *buf,
+		      u32 off, u32 len, u32 pkt_hdr)
+{
+	u32 seg = 1U << priv->rx_seg_shift;
+	struct ax88179_rx_src src;
+	u8 copy[AX_RX_HDR_LEN];
+	unsigned int hlen, peek;
+	struct sk_buff *skb;
+	const u8 *data;
+	u32 pos, n;
+
+	ax88179_rx_ring_src(priv, buf, &src);
+
+	/* Enough of the frame in one piece to find the headers */
+	peek = min_t(u32, len, AX_RX_HDR_LEN);
+	data = ax88179_rx_src_ptr(&src, off, peek);
+	if (!data) {
+		ax88179_rx_src_copy(&src, off, copy, peek);
+		data = copy;
+	}
+
+	hlen = len;
+	if (hlen > AX_RX_HDR_LEN && hlen > priv->rx_copybreak)
+		hlen = eth_get_headlen(priv->dev->net, data,
+				       AX_RX_HDR_LEN);
+
+	skb = napi_alloc_skb(&priv->napi, hlen);
+	if (!skb)
+		return NULL;
+
+	ax88179_rx_src_copy(&src, off, skb_put(skb, hlen), hlen);
+
+	for (pos = off + hlen; pos < off + len; pos += n) {
+		int i = pos >> priv->rx_seg_shift;
+		u32 poff = pos & (seg - 1);
+
+		n = min(off + len - pos, seg - poff);
+		ax88179_rx_page_ref(priv, buf, i, skb);
+		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, buf->page[i],
+				poff, n, seg);
+	}
+
+	ax88179_rx_meta(priv, skb, pkt_hdr);
+
+	return skb;
+}
+static void ax88179_rx_complete(struct urb *urb)
+{
+	struct ax88179_rx_buf *buf = urb->context;
+	struct ax88179_priv *priv = buf->priv;
+	struct usbnet *dev = priv->dev;
+	unsigned long flags;
+
+	switch (urb->status) {
+	case 0:
+		spin_lock_irqsave(&priv->rx_lock, flags);
+		buf->state = AX_RX_BUF_DONE;
+		list_add_tail(&buf->list, &priv->rx_done);
+		spin_unlock_irqrestore(&priv->rx_lock, flags);
+
+		napi_schedule(&priv->napi);
+		return;
+
+	/* killed, unlinked or unplugged */
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		buf->state = AX_RX_BUF_IDLE;
+		return;
+
+	case -EPIPE:
+		usbnet_defer_kevent(dev, EVENT_RX_HALT);
+		fallthrough;
+	default:
+		dev->net->stats.rx_errors++;
+		buf->state = AX_RX_BUF_IDLE;
+		if (priv->rx_ring_on)
+			schedule_delayed_work(&priv->rx_refill,
+					      AX_RX_REFILL_DELAY);
+		return;
+	}
+}
+
+static int ax88179_rx_buf_submit(struct ax88179_priv *priv,
+				 struct ax88179_rx_buf *buf, gfp_t gfp)
+{
+	u32 seg = 1U << priv->rx_seg_shift;
+	struct usbnet *dev = priv->dev;
+	struct urb *urb = buf->urb;
+	int i, ret;
+
+	/* Only the pages the stack still holds frames of are replaced */
+	for (i = 0; i < priv->rx_segs; i++) {
+		if (buf->page[i] && !ax88179_rx_page_reuse(priv, buf, i))
+			buf->page[i] = NULL;
+
+		if (buf->page[i]) {
+			priv->stats.rx_pool_hit++;
+		} else {
+			if (ax88179_rx_page_alloc(priv, buf, i, gfp))
+				return -ENOMEM;
+			priv->stats.rx_pool_miss++;
+		}
+	}
+
+	if (priv->rx_segs == 1) {
+		usb_fill_bulk_urb(urb, dev->udev, dev->in,
+				  page_address(buf->page[0]), AX_RX_BUF_SIZE,
+				  ax88179_rx_complete, buf);
+#ifdef AX_RX_PAGE_POOL
+		if (priv->rx_pool) {
+			urb->transfer_dma = page_pool_get_dma_addr(buf->page[0]);
+			urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+		}
+#endif
+	} else {
+		usb_fill_bulk_urb(urb, dev->udev, dev->in, NULL,
+				  AX_RX_BUF_SIZE, ax88179_rx_complete, buf);
+		sg_init_table(buf->sg, priv->rx_segs);
+		for (i = 0; i < priv->rx_segs; i++)
+			sg_set_page(&buf->sg[i], buf->page[i],
+				    min_t(u32, seg, AX_RX_BUF_SIZE - i * seg), 0);
+		urb->sg = buf->sg;
+		urb->num_sgs = priv->rx_segs;
+#ifdef AX_RX_PAGE_POOL
+		/* The pool's mappings stand in for usb_hcd_map_urb_for_dma() */
+		if (priv->rx_pool) {
+			for (i = 0; i < priv->rx_segs; i++) {
+				sg_dma_address(&buf->sg[i]) =
+					page_pool_get_dma_addr(buf->page[i]);
+				sg_dma_len(&buf->sg[i]) = buf->sg[i].length;
+			}
+			urb->num_mapped_sgs = priv->rx_segs;
+			urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+		}
+#endif
+	}
+
+	buf->state = AX_RX_BUF_SUBMITTED;
+	ret = usb_submit_urb(buf->urb, gfp);
+	if (ret)
+		buf->state = AX_RX_BUF_IDLE;
+
+	return ret;
+}
+
+/* Give a buffer back to the hardware, or leave it to the refill work */
+static void ax88179_rx_buf_resubmit(struct ax88179_priv *priv,
+				    struct ax88179_rx_buf *buf, gfp_t gfp)
+{
+	if (priv->rx_ring_on && !ax88179_rx_buf_submit(priv, buf, gfp))
+		return;
+
+	buf->state = AX_RX_BUF_IDLE;
+	if (priv->rx_ring_on)
+		schedule_delayed_work(&priv->rx_refill, AX_RX_REFILL_DELAY);
+}
+
+/* Take ownership of an idle buffer, 0 if someone else has it */
+static int ax88179_rx_buf_claim(struct ax88179_priv *priv,
+				struct ax88179_rx_buf *buf)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&priv->rx_lock, flags);
+	if (buf->state == AX_RX_BUF_IDLE) {
+		buf->state = AX_RX_BUF_SUBMITTED;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&priv->rx_lock, flags);
+
+	return ret;
+}
+
+static void ax88179_rx_refill_work(struct work_struct *work)
+{
+	struct ax88179_priv *priv = container_of(work, struct ax88179_priv,
+						 rx_refill.work);
+	int i;
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++) {
+		struct ax88179_rx_buf *buf = &priv->rx_ring[i];
+
+		if (!priv->rx_ring_on)
+			return;
+		if (ax88179_rx_buf_claim(priv, buf))
+			ax88179_rx_buf_resubmit(priv, buf, GFP_KERNEL);
+	}
+}
+
+/* usbnet's own bulk-in URBs must be paused before the ring is started */
+static void ax88179_rx_ring_start(struct ax88179_priv *priv)
+{
+	int i;
+
+	if (priv->rx_ring_on)
+		return;
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++)
+		usb_unpoison_urb(priv->rx_ring[i].urb);
+
+	priv->rx_ring_on = 1;
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++) {
+		struct ax88179_rx_buf *buf = &priv->rx_ring[i];
+
+		if (ax88179_rx_buf_claim(priv, buf))
+			ax88179_rx_buf_resubmit(priv, buf, GFP_KERNEL);
+	}
+}
+
+/* Completed buffers are left on rx_done for the poll to drain */
+static void ax88179_rx_ring_stop(struct ax88179_priv *priv)
+{
+	int i;
+
+	if (!priv->rx_ring_on)
+		return;
+
+	priv->rx_ring_on = 0;
+
+	/* Poisoning also fails any resubmit racing with us */
+	for (i = 0; i < AX_RX_RING_SIZE; i++)
+		usb_poison_urb(priv->rx_ring[i].urb);
+
+	cancel_delayed_work_sync(&priv->rx_refill);
+}
+
+/* Drop what the poll did not get to; NAPI must be disabled */
+static void ax88179_rx_ring_flush(struct ax88179_priv *priv)
+{
+	int i;
+
+	INIT_LIST_HEAD(&priv->rx_done);
+	priv->rx_cur = NULL;
+
+	for (i = 0; i < AX_RX_RING_SIZE; i++)
+		priv->rx_ring[i].state = AX_RX_BUF_IDLE;
+}
+
+#ifdef AX_XDP
+static void ax88179_xdp_tx_complete(struct urb *urb)
+{
+	struct ax88179_xdp_tx *tx = urb->context;
+	struct ax88179_priv *priv = tx->priv;
+	struct net_device *net = priv->dev->net;
+
+	if (urb->status)
+		net->stats.tx_errors += tx->frames;
+	else
+		dev_sw_netstats_tx_add(net, tx->frames, tx->bytes);
+
+	/* usbnet's kevent clears the stall, as for its own bulk-out URBs */
+	if (urb->status == -EPIPE)
+		usbnet_defer_kevent(priv->dev, EVENT_TX_HALT);
+
+	WRITE_ONCE(tx->busy, 0);
+	napi_schedule(&priv->napi);
+}
+
+/* An idle buffer of the XDP bulk-out set, NULL if all are in flight */
+static struct ax88179_xdp_tx *ax88179_xdp_tx_get(struct ax88179_priv *priv)
+{
+	struct ax88179_xdp_tx *tx;
+	int i;
+
+	for (i = 0; i < AX_XDP_TX_URBS; i++) {
+		tx = &priv->xdp_tx[i];
+		if (READ_ONCE(tx->busy) || tx->descs || tx == priv->xdp_tx_cur)
+			continue;
+
+		tx->len = 0;
+		tx->last = 0;
+		tx->frames = 0;
+		tx->bytes = 0;
+		return tx;
+	}
+
+	return NULL;
+}
+
+/* These URBs bypass usbnet's txq, so check what usbnet_start_xmit would */
+static bool ax88179_xdp_tx_ready(struct usbnet *dev)
+{
+	return netif_carrier_ok(dev->net) &&
+	       !test_bit(EVENT_DEV_ASLEEP, &dev->flags) &&
+	       !test_bit(EVENT_TX_HALT, &dev->flags);
+}
+
+static bool ax88179_xdp_tx_room(struct ax88179_xdp_tx *tx, u32 len)
+{
+	/* One more byte for the padding the submit may add */
+	return ALIGN(tx->len, AX_TX_ALIGN) + AX_TX_HDR_LEN + len + 1 <=
+	       AX_XDP_TX_BUF_SIZE;
+}
+
+/* Append a frame behind the bulk-out header tx_fixup would give it */
+static void ax88179_xdp_tx_add(struct ax88179_xdp_tx *tx, const void *data,
+			       u32 len)
+{
+	__le32 *hdr;
+
+	tx->len = ALIGN(tx->len, AX_TX_ALIGN);
+	hdr = (__le32 *)(tx->buf + tx->len);
+	hdr[0] = cpu_to_le32(len);
+	hdr[1] = 0;
+	memcpy(tx->buf + tx->len + AX_TX_HDR_LEN, data, len);
+	tx->last = tx->len;
+	tx->len += AX_TX_HDR_LEN + len;
+	tx->frames++;
+	tx->bytes += len;
+}
+
+static int ax88179_xdp_tx_submit(struct ax88179_priv *priv,
+				 struct ax88179_xdp_tx *tx)
+{
+	struct usbnet *dev = priv->dev;
+	__le32 *hdr;
+	int ret;
+
+	if (!ax88179_xdp_tx_ready(dev)) {
+		dev->net->stats.tx_dropped += tx->frames;
+		return -ENOLINK;
+	}
+
+	/* Enable padding, as tx_fixup does for single frames */
+	if ((tx->len % dev->maxpacket) == 0) {
+		hdr = (__le32 *)(tx->buf + tx->last);
+		hdr[1] |= cpu_to_le32(0x80008000);
+		tx->buf[tx->len++] = 0;
+	}
+
+	usb_fill_bulk_urb(tx->urb, dev->udev, dev->out, tx->buf, tx->len,
+			  ax88179_xdp_tx_complete, tx);
+	usb_anchor_urb(tx->urb, &priv->xdp_tx_anchor);
+	WRITE_ONCE(tx->busy, 1);
+	ret = usb_submit_urb(tx->urb, GFP_ATOMIC);
+	if (ret) {
+		usb_unanchor_urb(tx->urb);
+		WRITE_ONCE(tx->busy, 0);
+		dev->net->stats.tx_errors += tx->frames;
+	}
+
+	return ret;
+}
+
+/* Send what XDP_TX packed; once per NAPI poll */
+static void ax88179_xdp_tx_flush(struct ax88179_priv *priv)
+{
+	struct ax88179_xdp_tx *tx = priv->xdp_tx_cur;
+
+	if (!tx)
+		return;
+
+	priv->xdp_tx_cur = NULL;
+	ax88179_xdp_tx_submit(priv, tx);
+}
+
+static void ax88179_xdp_tx_stop(struct ax88179_priv *priv)
+{
+	usb_kill_anchored_urbs(&priv->xdp_tx_anchor);
+	priv->xdp_tx_cur = NULL;
+}
+
+/* XDP_TX frames are copied into a driver-owned bulk-out buffer, no skb */
+static int ax88179_xdp_tx(struct ax88179_priv *priv, struct xdp_buff *xdp)
+{
+	struct ax88179_xdp_tx *tx = priv->xdp_tx_cur;
+	u32 len = xdp->data_end - xdp->data;
+
+	if (!ax88179_xdp_tx_ready(priv->dev))
+		return -ENOLINK;
+
+	if (tx && !ax88179_xdp_tx_room(tx, len)) {
+		ax88179_xdp_tx_flush(priv);
+		tx = NULL;
+	}
+
+	if (!tx) {
+		tx = ax88179_xdp_tx_get(priv);
+		if (!tx)
+			return -EBUSY;
+		priv->xdp_tx_cur = tx;
+	}
+
+	ax88179_xdp_tx_add(tx, xdp->data, len);
+
+	return 0;
+}
+
+#ifdef AX_XSK
+/* Copy the frame straight into a UMEM frame from the fill ring; an AF_XDP
+ * socket then receives it without a second copy.
+ */
+static int ax88179_xsk_redirect(struct ax88179_priv *priv,
+				struct xsk_buff_pool *pool,
+				struct bpf_prog *prog, struct xdp_buff *xdp)
+{
+	u32 len = xdp->data_end - xdp->data;
+	struct xdp_buff *xsk;
+	int ret;
+
+	if (len > xsk_pool_get_rx_frame_size(pool))
+		return -EMSGSIZE;
+
+	xsk = xsk_buff_alloc(pool);
+	if (!xsk) {
+		priv->stats.rx_xsk_nobuf++;
+		return -ENOBUFS;
+	}
+	xsk_buff_set_size(xsk, len);
+	memcpy(xsk->data, xdp->data, len);
+
+	ret = xdp_do_redirect(priv->dev->net, xsk, prog);
+	if (ret)
+		xsk_buff_free(xsk);
+
+	return ret;
+}
+#endif
+
+/* The bulk-in page is shared by the whole transfer, redirect a copy */
+static int ax88179_xdp_redirect(struct ax88179_priv *priv,
+				struct bpf_prog *prog, struct xdp_buff *xdp)
+{
+	u32 len = xdp->data_end - xdp->data;
+#ifdef AX_XSK
+	struct xsk_buff_pool *pool = READ_ONCE(priv->xsk_pool);
+#endif
+	struct xdp_buff copy;
+	struct page *page;
+	int ret;
+
+#ifdef AX_XSK
+	/* Other targets still work from a page once the fill ring is empty */
+	if (pool) {
+		ret = ax88179_xsk_redirect(priv, pool, prog, xdp);
+		if (ret != -ENOBUFS)
+			return ret;
+	}
+#endif
+
+	if (len > AX_XDP_MAX_LEN)
+		return -EMSGSIZE;
+
+	page = dev_alloc_page();
+	if (!page)
+		return -ENOMEM;
+
+	xdp_init_buff(&copy, PAGE_SIZE, &priv->xdp_rxq);
+	xdp_prepare_buff(&copy, page_address(page), XDP_PACKET_HEADROOM, len,
+			 false);
+	memcpy(copy.data, xdp->data, len);
+
+	ret = xdp_do_redirect(priv->dev->net, &copy, prog);
+	if (ret)
+		put_page(page);
+
+	return ret;
+}
+
+/* Run the program on a frame in place.  There is no headroom and no
+ * tailroom: the bytes around the frame belong to its neighbours.
+ */
+static u32 ax88179_rx_xdp(struct ax88179_priv *priv, struct bpf_prog *prog,
+			  u8 **data, u32 *len)
+{
+	struct net_device *net = priv->dev->net;
+	struct xdp_buff xdp;
+	u32 act;
+
+	xdp_init_buff(&xdp, *len + SKB_DATA_ALIGN(sizeof(struct skb_shared_info)),
+		      &priv->xdp_rxq);
+	xdp_prepare_buff(&xdp, *data, 0, *len, false);
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+
+	*data = xdp.data;
+	*len = xdp.data_end - xdp.data;
+
+	switch (act) {
+	case XDP_PASS:
+		return XDP_PASS;
+	case XDP_TX:
+		if (ax88179_xdp_tx(priv, &xdp))
+			break;
+		priv->stats.rx_xdp_tx++;
+		return XDP_TX;
+	case XDP_REDIRECT:
+		if (ax88179_xdp_redirect(priv, prog, &xdp))
+			break;
+		priv->xdp_flush = 1;
+		priv->stats.rx_xdp_redirect++;
+		return XDP_REDIRECT;
+	default:
+		bpf_warn_invalid_xdp_action(net, prog, act);
+		fallthrough;
+	case XDP_ABORTED:
+		break;
+	case XDP_DROP:
+		priv->stats.rx_xdp_drop++;
+		return XDP_DROP;
+	}
+
+	trace_xdp_exception(net, prog, act);
+	priv->stats.rx_xdp_aborted++;
+
+	return XDP_ABORTED;
+}
+
+/* XDP ran on a copy of the frame, which goes up whole */
+static struct sk_buff *ax88179_rx_build_copy(struct ax88179_priv *priv,
+					     const u8 *data, u32 len,
+					     u32 pkt_hdr)
+{
+	struct sk_buff *skb;
+
+	skb = napi_alloc_skb(&priv->napi, len);
+	if (!skb)
+		return NULL;
+
+	skb_put_data(skb, data, len);
+	ax88179_rx_meta(priv, skb, pkt_hdr);
+
+	return skb;
+}
+
+static void ax88179_xdp_flush(struct ax88179_priv *priv)
+{
+	if (priv->xdp_flush) {
+		xdp_do_flush();
+		priv->xdp_flush = 0;
+	}
+}
+#endif
+
+#ifdef AX_XSK
+/* Return the descriptors of finished xdp_tx URBs to the completion ring,
+ * in the order they were taken from the TX ring. Runs in the NAPI poll, or
+ * with NAPI disabled, so the completion ring has a single producer.
+ */
+static void ax88179_xsk_tx_complete(struct ax88179_priv *priv)
+{
+	struct xsk_buff_pool *pool = READ_ONCE(priv->xsk_pool);
+	struct ax88179_xdp_tx *tx;
+	int i;
+
+	if (!pool)
+		return;
+
+	for (;;) {
+		for (i = 0; i < AX_XDP_TX_URBS; i++) {
+			tx = &priv->xdp_tx[i];
+			if (tx->descs && tx->seq == priv->xsk_tx_done)
+				break;
+		}
+		if (i == AX_XDP_TX_URBS || READ_ONCE(tx->busy))
+			return;
+
+		xsk_tx_completed(pool, tx->descs);
+		tx->descs = 0;
+		priv->xsk_tx_done++;
+	}
+}
+
+/* Pack pending AF_XDP TX descriptors into the idle XDP bulk-out buffers.
+ * The descriptors complete once the URB carrying them is done.
+ */
+static void ax88179_xsk_tx_poll(struct ax88179_priv *priv)
+{
+	struct xsk_buff_pool *pool = READ_ONCE(priv->xsk_pool);
+	struct usbnet *dev = priv->dev;
+	u32 max_len = dev->net->mtu + ETH_HLEN + VLAN_HLEN;
+	struct ax88179_xdp_tx *tx;
+	struct xdp_desc desc;
+	u32 done;
+
+	if (!pool)
+		return;
+
+	ax88179_xsk_tx_complete(priv);
+
+	/* Descriptors stay in the ring until the endpoint can take them */
+	if (!ax88179_xdp_tx_ready(dev))
+		goto out;
+
+	while ((tx = ax88179_xdp_tx_get(priv))) {
+		done = 0;
+		while (ax88179_xdp_tx_room(tx, max_len) &&
+		       xsk_tx_peek_desc(pool, &desc)) {
+			done++;
+			if (desc.len > max_len) {
+				dev->net->stats.tx_dropped++;
+				continue;
+			}
+			ax88179_xdp_tx_add(tx,
+					   xsk_buff_raw_get_data(pool, desc.addr),
+					   desc.len);
+		}
+
+		if (!done)
+			break;
+		xsk_tx_release(pool);
+		/* Failed or empty transfers complete in turn, like sent ones */
+		tx->descs = done;
+		tx->seq = priv->xsk_tx_seq++;
+		if (!tx->frames)
 			continue;
+
+		if (ax88179_xdp_tx_submit(priv, tx))
+			break;
+		priv->stats.tx_xsk_frames += tx->frames;
+	}
+	ax88179_xsk_tx_complete(priv);
+
+out:
+	/* Nothing polls the TX ring until user space kicks it again */
+	if (xsk_uses_need_wakeup(pool))
+		xsk_set_tx_need_wakeup(pool);
+}
+#endif
+
+static struct ax88179_rx_buf *ax88179_rx_done_dequeue(struct ax88179_priv *priv)
+{
+	struct ax88179_rx_buf *buf = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->rx_lock, flags);
+	if (!list_empty(&priv->rx_done)) {
+		buf = list_first_entry(&priv->rx_done, struct ax88179_rx_buf,
+				       list);
+		list_del(&buf->list);
+	}
+	spin_unlock_irqrestore(&priv->rx_lock, flags);
+
+	return buf;
+}
+
+/* Deliver frames of completed ring buffers; a buffer goes back to the
+ * hardware as soon as its last frame has been handed up.
+ */
+static int ax88179_rx_ring_poll(struct ax88179_priv *priv, int budget)
+{
+#ifdef AX_XDP
+	struct bpf_prog *xdp_prog = READ_ONCE(priv->xdp_prog);
+#endif
+	struct ax88179_rx_agg *agg = &priv->rx_agg;
+	struct usbnet *dev = priv->dev;
+	struct ax88179_rx_buf *buf;
+	struct ax88179_rx_src src;
+	struct sk_buff *skb;
+	u32 pkt_off, pkt_hdr;
+	u16 pkt_len;
+	int work = 0;
+
+	while (work < budget) {
+		buf = priv->rx_cur;
+		if (!buf) {
+			buf = ax88179_rx_done_dequeue(priv);
+			if (!buf)
+				break;
+
+			ax88179_rx_buf_sync(priv, buf);
+			ax88179_rx_ring_src(priv, buf, &src);
+			if (!ax88179_rx_agg_init(dev, &src,
+						 buf->urb->actual_length,
+						 agg)) {
+				dev->net->stats.rx_errors++;
+				ax88179_rx_buf_resubmit(priv, buf, GFP_ATOMIC);
+				continue;
+			}
+			ax88179_dim_count(priv, agg->pkt_cnt,
+					  buf->urb->actual_length);
+			priv->rx_cur = buf;
 		}
 
-		if (pkt_cnt == 0) {			
+		ax88179_rx_ring_src(priv, buf, &src);
+		while (work < budget &&
+		       ax88179_rx_agg_next(&src, agg, &pkt_off, &pkt_len,
+					   &pkt_hdr)) {
+			u32 off = pkt_off, len = pkt_len;
+
+			work++;
+
+			/* Skip IP alignment psudo header */
+			if (NET_IP_ALIGN == 0) {
+				if (len <= 2) {
+					dev->net->stats.rx_errors++;
+					continue;
+				}
+				off += 2;
+				len -= 2;
+			}
+
+			skb = NULL;
+#ifdef AX_XDP
+			if (xdp_prog) {
+				const u8 *in = ax88179_rx_src_ptr(&src, off, len);
+				u8 *data = (u8 *)in;
+
+				/* A frame across two ring pages runs on a copy,
+				 * which then goes up whole
+				 */
+				if (!in) {
+					data = priv->xdp_rx_buf;
+					ax88179_rx_src_copy(&src, off, data, len);
+				}
+				if (ax88179_rx_xdp(priv, xdp_prog, &data,
+						   &len) != XDP_PASS)
+					continue;
+
+				if (in) {
+					off += data - in;
+				} else {
+					skb = ax88179_rx_build_copy(priv, data,
+								    len, pkt_hdr);
+					if (!skb) {
+						dev->net->stats.rx_dropped++;
+						continue;
+					}
+				}
+			}
+#endif
+
+			if (!skb)
+				skb = ax88179_rx_build_frag(priv, buf, off, len,
+							    pkt_hdr);
+			if (!skb) {
+				dev->net->stats.rx_dropped++;
+				continue;
+			}
+			ax88179_napi_deliver(priv, skb);
+		}
+
+		/* Budget ran out in the middle of this transfer */
+		if (agg->pkt_cnt)
+			break;
+
+#ifdef AX_XDP
+		ax88179_xdp_flush(priv);
+#endif
+		priv->rx_cur = NULL;
+		ax88179_rx_buf_resubmit(priv, buf, GFP_ATOMIC);
+	}
+
+#ifdef AX_XDP
+	ax88179_xdp_flush(priv);
+#endif
+
+	return work;
+}
+
+/* Transfers that arrived on usbnet's URBs, e.g. while the ring took over */
+static int ax88179_rx_queue_poll(struct ax88179_priv *priv, int budget)
+{
+	struct usbnet *dev = priv->dev;
+	struct ax88179_rx_src src = { 0 };
+	struct ax88179_rx_agg *agg;
+	struct sk_buff *skb, *ax_skb;
+	u32 pkt_off, pkt_hdr;
+	u16 pkt_len;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&priv->rx_napi_q);
+		if (!skb)
+			break;
+
+		src.data = skb->data;
+		agg = (struct ax88179_rx_agg *)skb->cb;
+		if (!agg->parsed) {
+			if (!ax88179_rx_agg_init(dev, &src, skb->len, agg)) {
+				dev->net->stats.rx_errors++;
+				dev_kfree_skb(skb);
+				continue;
+			}
+			ax88179_dim_count(priv, agg->pkt_cnt, skb->len);
+		}
+
+		while (work < budget &&
+		       ax88179_rx_agg_next(&src, agg, &pkt_off, &pkt_len,
+					   &pkt_hdr)) {
+			ax_skb = ax88179_rx_build(dev, skb, pkt_off, pkt_len,
+						  pkt_hdr);
+			if (!ax_skb) {
+				dev->net->stats.rx_dropped++;
+				continue;
+			}
+			ax88179_napi_deliver(priv, ax_skb);
+			work++;
+		}
+
+		/* Budget ran out in the middle of this transfer */
+		if (agg->pkt_cnt) {
+			skb_queue_head(&priv->rx_napi_q, skb);
+			break;
+		}
+		consume_skb(skb);
+	}
+
+	return work;
+}
+
+static int ax88179_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct ax88179_priv *priv = container_of(napi, struct ax88179_priv,
+						 napi);
+	int work;
+
+#ifdef AX_XSK
+	ax88179_xsk_tx_poll(priv);
+#endif
+	work = ax88179_rx_ring_poll(priv, budget);
+#ifdef AX_XDP
+	ax88179_xdp_tx_flush(priv);
+#endif
+	if (work < budget)
+		work += ax88179_rx_queue_poll(priv, budget - work);
+
+	ax88179_dim_update(priv);
+
+	if (work < budget)
+		napi_complete_done(napi, work);
+
+	return work;
+}
+
+/* Hand the whole transfer to NAPI; frames are split off in the poll */
+static int ax88179_napi_queue(struct ax88179_priv *priv, struct sk_buff *skb)
+{
+	struct ax88179_rx_agg *agg;
+	struct sk_buff *urb_skb;
+
+	/* usbnet frees the bulk-in skb once we return (FLAG_MULTI_PACKET) */
+	urb_skb = skb_clone(skb, GFP_ATOMIC);
+	if (!urb_skb)
+		return 0;
+
+	agg = (struct ax88179_rx_agg *)urb_skb->cb;
+	agg->parsed = 0;
+
+	skb_queue_tail(&priv->rx_napi_q, urb_skb);
+	napi_schedule(&priv->napi);
+
+	return 1;
+}
+#endif
+
+static int ax88179_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct ax88179_rx_src src = { .data = skb->data };
+	struct ax88179_rx_agg agg;
+	struct sk_buff *ax_skb = NULL;
+	u32 pkt_off, pkt_hdr;
+	u16 pkt_len;
+
+	if (skb->len == 0) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+		netdev_err(dev->net, "RX SKB length zero");
+#else
+		deverr(dev, "RX SKB length zero");
+#endif
+		dev->net->stats.rx_errors++;
+		return 0;
+	}
+
+#ifdef AX_NAPI_RX
+	if (priv->flags & AX_PRIV_FLAG_RX_NAPI)
+		return ax88179_napi_queue(priv, skb);
+#endif
+
+	/* skb->cb belongs to usbnet, keep the cursor on the stack */
+	if (!ax88179_rx_agg_init(dev, &src, skb->len, &agg))
+		return 0;
+
+	ax88179_dim_count(priv, agg.pkt_cnt, skb->len);
+	ax88179_dim_update(priv);
+
+	while (ax88179_rx_agg_next(&src, &agg, &pkt_off, &pkt_len, &pkt_hdr)) {
+		if (!AX_FLAG_MULTI_PACKET && agg.pkt_cnt == 0) {
+			/* usbnet passes the bulk-in skb up as the last frame */
+			skb_pull(skb, pkt_off);
 			skb->len = pkt_len;
 
 			/* Skip IP alignment psudo header */
@@ -1822,55 +4685,90 @@ static int ax88179_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 #else
 			skb_set_tail_pointer(skb, skb->len);
 #endif
-			skb->truesize = skb->len + sizeof(struct sk_buff);
-			ax88179_rx_checksum(skb, pkt_hdr);
+			ax88179_rx_meta(priv, skb, pkt_hdr);
 
 			return 1;
 		}
 
-#ifndef RX_SKB_COPY
-		ax_skb = skb_clone(skb, GFP_ATOMIC);
-#else
-		ax_skb = alloc_skb(pkt_len + NET_IP_ALIGN, GFP_ATOMIC);
-		skb_reserve(ax_skb, NET_IP_ALIGN);
-#endif
+		ax_skb = ax88179_rx_build(dev, skb, pkt_off, pkt_len, pkt_hdr);
+		if (!ax_skb)
+			return 0;
+
+		usbnet_skb_return(dev, ax_skb);
+	}
+
+	/* Nothing left that usbnet could pass up */
+	return AX_FLAG_MULTI_PACKET ? 1 : 0;
+}
+
+#ifdef AX_TX_BOUNCE
+/* Copy the frame behind its header into an idle slot of the bounce ring,
+ * in one pass; NULL while every slot is still in flight
+ */
+static struct sk_buff *ax88179_tx_bounce(struct ax88179_priv *priv,
+					 struct sk_buff *skb,
+					 u32 tx_hdr1, u32 tx_hdr2)
+{
+	struct page *page = NULL;
+	struct sk_buff *out;
+	__le32 *hdr;
+	int i;
+
+	if (AX_TX_HDR_LEN + skb->len + 1 > AX_TX_BOUNCE_LEN)
+		return NULL;
+
+	/* A slot is idle again once usbnet freed the skb built on it */
+	for (i = 0; i < AX_TX_BOUNCE_SLOTS && !page; i++) {
+		page = priv->tx_bounce[priv->tx_bounce_next];
+		priv->tx_bounce_next = (priv->tx_bounce_next + 1) %
+				       AX_TX_BOUNCE_SLOTS;
+		if (page && page_count(page) != 1)
+			page = NULL;
+	}
+	if (!page)
+		return NULL;
+
+	out = build_skb(page_address(page), PAGE_SIZE << AX_TX_BOUNCE_ORDER);
+	if (!out)
+		return NULL;
+	/* Freeing the skb drops this reference, not the ring's */
+	get_page(page);
+
+	hdr = (__le32 *)__skb_put(out, AX_TX_HDR_LEN);
+	hdr[0] = cpu_to_le32(tx_hdr1);
+	hdr[1] = cpu_to_le32(tx_hdr2);
+	skb_copy_bits(skb, 0, __skb_put(out, skb->len), skb->len);
+	if (tx_hdr2 & 0x80008000)
+		*(u8 *)__skb_put(out, 1) = 0;
 
-		if (ax_skb) {
-#ifndef RX_SKB_COPY
-			ax_skb->len = pkt_len;
-	
-			/* Skip IP alignment psudo header */
-			if (NET_IP_ALIGN == 0)
-				skb_pull(ax_skb, 2);
+	dev_consume_skb_any(skb);
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 22)
-			ax_skb->tail = ax_skb->data + ax_skb->len;
-#else
-			skb_set_tail_pointer(ax_skb, ax_skb->len);
+	return out;
+}
 #endif
 
-#else
-			skb_put(ax_skb, pkt_len);
-			memcpy(ax_skb->data, skb->data, pkt_len);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
+/* Bounce ring busy: one reallocation makes room for the header and the
+ * padding byte and the fragments are pulled in behind the linear part, so
+ * every byte is still copied once.
+ */
+static int ax88179_tx_pull(struct sk_buff *skb, gfp_t flags)
+{
+	int nhead = max_t(int, AX_TX_HDR_LEN - (int)skb_headroom(skb), 0);
+	int ntail = max_t(int, skb->data_len + 1 - (int)skb_tailroom(skb), 0);
 
-			if (NET_IP_ALIGN == 0)
-				skb_pull(ax_skb, 2);
-#endif
-			ax_skb->truesize = ax_skb->len + sizeof(struct sk_buff);
-			ax88179_rx_checksum(ax_skb, pkt_hdr);
-			usbnet_skb_return(dev, ax_skb);
-		} else {
-			return 0;
-		}
+	if (pskb_expand_head(skb, nhead, ntail, flags))
+		return -ENOMEM;
+	if (!__pskb_pull_tail(skb, skb->data_len))
+		return -ENOMEM;
 
-		skb_pull(skb, (pkt_len + 7) & 0xFFF8);
-		pkt_hdr++;
-	}
-	return 1;
+	return 0;
 }
+#endif
 
+/* Prepend the bulk-out header to a frame that is sent on its own */
 static struct sk_buff *
-ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
+ax88179_tx_frame(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
 {
 	u32 tx_hdr1 = 0, tx_hdr2 = 0;
 	int frame_size = dev->maxpacket;
@@ -1879,8 +4777,14 @@ ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
 #else
 	int mss = 0;
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	bool sg = dev->can_dma_sg;
+	struct sk_buff *out;
+#else
 	int headroom = 0;
 	int tailroom = 0;
+#endif
 
 	tx_hdr1 = skb->len;
 	tx_hdr2 = mss;
@@ -1888,12 +4792,41 @@ ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
 		tx_hdr2 |= 0x80008000;	/* Enable padding */
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
-	if (!dev->can_dma_sg && (dev->net->features & NETIF_F_SG) &&
-	    skb_linearize(skb))
-		return NULL;
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
+#ifdef AX_NAPI_RX
+	/* FLAG_MULTI_PACKET: the padding byte cannot follow the fragments */
+	if (tx_hdr2 & 0x80008000)
+		sg = false;
+#endif
+	if (skb_is_nonlinear(skb)) {
+		if (sg) {
+			/* usbnet maps the fragments as they are; the header
+			 * goes into the headroom of the linear part
+			 */
+			priv->stats.tx_sg++;
+		} else {
+			out = ax88179_tx_bounce(priv, skb, tx_hdr1, tx_hdr2);
+			if (out) {
+				priv->stats.tx_bounce++;
+#ifdef AX_NAPI_RX
+				usbnet_set_skb_tx_stats(out, 1, 0);
+#endif
+				return out;
+			}
+			if (ax88179_tx_pull(skb, flags))
+				goto drop;
+			priv->stats.tx_pull++;
+		}
+	}
+
+	/* needed_headroom normally leaves room for the header */
+	if (skb_headroom(skb) < 8 || skb_header_cloned(skb))
+		priv->stats.tx_head_copy++;
+	if (skb_cow_head(skb, 8))
+		goto drop;
+#else
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
 	if ((dev->net->features & NETIF_F_SG) && skb_linearize(skb))
-		return NULL;
+		goto drop;
 #endif
 
 	headroom = skb_headroom(skb);
@@ -1914,8 +4847,9 @@ ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
 		dev_kfree_skb_any(skb);
 		skb = skb2;
 		if (!skb)
-			return NULL;
+			goto err;
 	}
+#endif
 
 	skb_push(skb, 4);
 	cpu_to_le32s(&tx_hdr2);
@@ -1933,174 +4867,563 @@ ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
 	skb_copy_to_linear_data(skb, &tx_hdr1, 4);
 #endif
 
+#ifdef AX_NAPI_RX
+	/* FLAG_MULTI_PACKET: usbnet leaves the padding byte to us */
+	if ((le32_to_cpu(tx_hdr2) & 0x80008000) &&
+	    skb_put_padto(skb, skb->len + 1))
+		goto err;
+
+	usbnet_set_skb_tx_stats(skb, 1, 0);
+#endif
+
 	return skb;
+
+drop:
+	dev_kfree_skb_any(skb);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 12, 0) || defined(AX_NAPI_RX)
+err:
+#endif
+	/* usbnet does not count NULL as a drop with FLAG_MULTI_PACKET */
+	if (AX_FLAG_MULTI_PACKET)
+		dev->net->stats.tx_dropped++;
+	return NULL;
 }
 
-static int ax88179_link_reset(struct usbnet *dev)
+#ifdef AX_TX_AGG
+/* Queue the frame being aggregated for transmission */
+static void ax88179_tx_agg_close(struct usbnet *dev, struct ax88179_priv *priv)
 {
-	struct ax88179_data *data = (struct ax88179_data *)&dev->data;
-	u8 *tmp, *link_sts, *tmp_16;
-	u16 *mode, *tmp16, delay = 10 * HZ;
-	u32 *tmp32;
-	unsigned long jtimeout = 0;
+	struct sk_buff *agg = priv->tx_agg;
+	__le32 *hdr;
 
-	tmp_16 = kmalloc(16, GFP_KERNEL);
-	if (!tmp_16)
-		return -ENOMEM;
-	tmp = (u8*)tmp_16;
-	link_sts = (u8*)(&tmp_16[5]);
-	mode = (u16*)(&tmp_16[6]);
-	tmp16 = (u16*)(&tmp_16[8]);
-	tmp32 = (u32*)(&tmp_16[10]);
-
-	*mode = AX_MEDIUM_TXFLOW_CTRLEN | AX_MEDIUM_RXFLOW_CTRLEN;
+	if (!agg)
+		return;
+	priv->tx_agg = NULL;
 
-	ax88179_read_cmd(dev, AX_ACCESS_MAC, PHYSICAL_LINK_STATUS,
-			 1, 1, link_sts, 0);
+	/* Enable padding on the last frame, as for single frames */
+	if ((agg->len % dev->maxpacket) == 0) {
+		hdr = (__le32 *)(agg->data + priv->tx_agg_last);
+		hdr[1] |= cpu_to_le32(0x80008000);
+		skb_put_u8(agg, 0);
+	}
 
-	jtimeout = jiffies + delay;
-	while(time_before(jiffies, jtimeout)) {
+	usbnet_set_skb_tx_stats(agg, priv->tx_agg_frames,
+				(long)priv->tx_agg_bytes - agg->len);
+	priv->stats.tx_agg_urbs++;
+	priv->stats.tx_agg_frames += priv->tx_agg_frames;
 
-		ax88179_read_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID, GMII_PHY_PHYSR, 2, tmp16, 1);
+	skb_queue_tail(&priv->tx_agg_q, agg);
+}
 
-		if (*tmp16 & GMII_PHY_PHYSR_LINK) {
-			break;
+/* Copy a frame behind its own header into the aggregate */
+static bool ax88179_tx_agg_add(struct usbnet *dev, struct ax88179_priv *priv,
+			       struct sk_buff *skb)
+{
+	struct sk_buff *agg = priv->tx_agg;
+	u32 len = skb->len;
+	__le32 *hdr;
+	u32 pad;
+
+	if (agg) {
+		pad = ALIGN(agg->len, AX_TX_ALIGN) - agg->len;
+		if (pad + AX_TX_HDR_LEN + len + 1 > (u32)skb_tailroom(agg)) {
+			ax88179_tx_agg_close(dev, priv);
+			agg = NULL;
 		}
 	}
 
-	if (!(*tmp16 & GMII_PHY_PHYSR_LINK))
-		return 0;
-	else if (GMII_PHY_PHYSR_GIGA == (*tmp16 & GMII_PHY_PHYSR_SMASK)) {
-		*mode |= AX_MEDIUM_GIGAMODE;
-		if (dev->net->mtu > 1500)
-			*mode |= AX_MEDIUM_JUMBO_EN;
+	if (!agg) {
+		agg = alloc_skb(SKB_WITH_OVERHEAD(AX_TX_AGG_SIZE), GFP_ATOMIC);
+		if (!agg)
+			return false;
+		priv->tx_agg = agg;
+		priv->tx_agg_frames = 0;
+		priv->tx_agg_bytes = 0;
+		pad = 0;
+	}
 
-		if (*link_sts & AX_USB_SS)
-			memcpy(tmp, &AX88179_BULKIN_SIZE[0], 5);
-		else if (*link_sts & AX_USB_HS)
-			memcpy(tmp, &AX88179_BULKIN_SIZE[1], 5);
-		else
-			memcpy(tmp, &AX88179_BULKIN_SIZE[3], 5);
-	} else if (GMII_PHY_PHYSR_100 == (*tmp16 & GMII_PHY_PHYSR_SMASK)) {
-		*mode |= AX_MEDIUM_PS;	/* Bit 9 : PS */
-		if (*link_sts & (AX_USB_SS | AX_USB_HS))
-			memcpy(tmp, &AX88179_BULKIN_SIZE[2], 5);
-		else
-			memcpy(tmp, &AX88179_BULKIN_SIZE[3], 5);
-	} else
-		memcpy(tmp, &AX88179_BULKIN_SIZE[3], 5);
+	skb_put_zero(agg, pad);
+	priv->tx_agg_last = agg->len;
+	hdr = skb_put(agg, AX_TX_HDR_LEN);
+	hdr[0] = cpu_to_le32(len);
+	hdr[1] = 0;
 
-	if (bsize != -1) {
-		if (bsize > 24)
-			bsize = 24;
+	skb_copy_bits(skb, 0, skb_put(agg, len), len);
 
-		else if (bsize == 0) {
-			tmp[1] = 0;
-			tmp[2] = 0;
+	priv->tx_agg_frames++;
+	priv->tx_agg_bytes += len;
+
+	return true;
+}
+
+/* tx-xmit-more: while the stack has more frames behind this one, the
+ * transfers already built wait in tx_agg_q and are submitted back to back
+ * when the burst ends
+ */
+static bool ax88179_tx_burst(struct usbnet *dev, struct ax88179_priv *priv)
+{
+	if (!(priv->flags & AX_PRIV_FLAG_TX_XMIT_MORE))
+		return false;
+
+	if (netdev_xmit_more() &&
+	    !netif_xmit_stopped(netdev_get_tx_queue(dev->net, 0)) &&
+	    skb_queue_len(&priv->tx_agg_q) < dev->tx_qlen) {
+		priv->stats.tx_xmit_more++;
+		priv->tx_burst = 1;
+		return true;
+	}
+
+	if (priv->tx_burst) {
+		priv->stats.tx_burst_end++;
+		priv->tx_burst = 0;
+	}
+	return false;
+}
+
+/* Collect frames into bulk-out transfers.  Returns the next transfer
+ * to submit, or NULL while the frames wait; with skb == NULL only flushes.
+ */
+static struct sk_buff *
+ax88179_tx_agg(struct usbnet *dev, struct ax88179_priv *priv,
+	       struct sk_buff *skb, gfp_t flags)
+{
+	struct net_device *net = dev->net;
+	struct sk_buff *out;
+	bool hold = false;
+
+	if (!skb) {
+		if (skb_queue_empty(&priv->tx_agg_q) && priv->tx_agg) {
+			priv->stats.tx_agg_timeout++;
+			ax88179_tx_agg_close(dev, priv);
 		}
+	} else if (!(priv->flags & AX_PRIV_FLAG_TX_AGG) || skb_is_gso(skb)) {
+		/* Keep the order: whatever is aggregated goes first */
+		ax88179_tx_agg_close(dev, priv);
+		out = ax88179_tx_frame(dev, skb, flags);
+		if (out)
+			skb_queue_tail(&priv->tx_agg_q, out);
+		hold = ax88179_tx_burst(dev, priv);
+	} else {
+		if (ax88179_tx_agg_add(dev, priv, skb)) {
+			dev_consume_skb_any(skb);
+		} else {
+			/* No aggregate buffer: send the frame on its own */
+			ax88179_tx_agg_close(dev, priv);
+			out = ax88179_tx_frame(dev, skb, flags);
+			if (out)
+				skb_queue_tail(&priv->tx_agg_q, out);
+		}
+
+		/* With tx-xmit-more the transfer also ends with the burst,
+		 * otherwise only size and timer end it.
+		 */
+		hold = ax88179_tx_burst(dev, priv);
+		if (netif_xmit_stopped(netdev_get_tx_queue(net, 0)) ||
+		    ((priv->flags & AX_PRIV_FLAG_TX_XMIT_MORE) && !hold))
+			ax88179_tx_agg_close(dev, priv);
+
+		if (priv->tx_agg && (u32)skb_tailroom(priv->tx_agg) <
+		    AX_TX_ALIGN + AX_TX_HDR_LEN + dev->hard_mtu + 1)
+			ax88179_tx_agg_close(dev, priv);
+	}
+
+	/* The timer and the tasklet only run once the burst is over */
+	if (hold)
+		return NULL;
+
+	out = skb_dequeue(&priv->tx_agg_q);
+
+	if (!skb_queue_empty(&priv->tx_agg_q))
+		tasklet_schedule(&priv->tx_agg_bh);
+	else if (priv->tx_agg && !hrtimer_active(&priv->tx_agg_timer))
+		hrtimer_start(&priv->tx_agg_timer,
+			      ns_to_ktime(AX_TX_AGG_TIMEOUT), HRTIMER_MODE_REL);
+
+	return out;
+}
+
+static enum hrtimer_restart ax88179_tx_agg_timer(struct hrtimer *timer)
+{
+	struct ax88179_priv *priv = container_of(timer, struct ax88179_priv,
+						 tx_agg_timer);
+
+	tasklet_schedule(&priv->tx_agg_bh);
+
+	return HRTIMER_NORESTART;
+}
 
-		tmp[3] = (u8)bsize;
+/* Submit what the xmit path left behind */
+static void ax88179_tx_agg_bh(struct tasklet_struct *t)
+{
+	struct ax88179_priv *priv = from_tasklet(priv, t, tx_agg_bh);
+	struct net_device *net = priv->dev->net;
+
+	netif_tx_lock_bh(net);
+	do {
+		usbnet_start_xmit(NULL, net);
+	} while (!skb_queue_empty(&priv->tx_agg_q));
+	netif_tx_unlock_bh(net);
+}
+
+/* Latency sensitive traffic: high skb->priority or DSCP */
+static bool ax88179_tx_is_prio(struct sk_buff *skb)
+{
+	struct ipv6hdr _ip6h, *ip6h;
+	struct iphdr _iph, *iph;
+	u8 dsfield = 0;
+
+	/* Larger values are classids (major:minor), not TC_PRIO_* */
+	if (skb->priority <= TC_PRIO_MAX && skb->priority >= AX_TX_PRIO_MIN)
+		return true;
+
+	switch (vlan_get_protocol(skb)) {
+	case htons(ETH_P_IP):
+		iph = skb_header_pointer(skb, skb_network_offset(skb),
+					 sizeof(_iph), &_iph);
+		if (iph)
+			dsfield = ipv4_get_dsfield(iph);
+		break;
+	case htons(ETH_P_IPV6):
+		ip6h = skb_header_pointer(skb, skb_network_offset(skb),
+					  sizeof(_ip6h), &_ip6h);
+		if (ip6h)
+			dsfield = ipv6_get_dsfield(ip6h);
+		break;
 	}
 
-	if (ifg != -1) {
-		if (ifg > 255)
-			ifg = 255;
-		tmp[4] = (u8)ifg;
+	return IPTOS_PREC(dsfield) >= AX_TX_PRIO_PREC_MIN;
+}
+
+static void ax88179_tx_agg_stop(struct ax88179_priv *priv)
+{
+	hrtimer_cancel(&priv->tx_agg_timer);
+	tasklet_kill(&priv->tx_agg_bh);
+
+	dev_kfree_skb(priv->tx_agg);
+	priv->tx_agg = NULL;
+	skb_queue_purge(&priv->tx_agg_q);
+	priv->tx_burst = 0;
+}
+#endif
+
+#ifdef AX_TX_BQL
+/* usbnet frees the skb of each URB once it completed or failed, the only
+ * completion a minidriver sees; report the whole transfer to BQL then
+ */
+static void ax88179_tx_bql_done(struct sk_buff *skb)
+{
+	struct skb_data *entry = (struct skb_data *)skb->cb;
+
+	netdev_completed_queue(skb->dev, entry->packets, skb->len);
+
+	/* The socket's own destructor runs now, as it would have */
+	if (AX_TX_CB(skb)->orig)
+		dev_consume_skb_any(AX_TX_CB(skb)->orig);
+}
+
+/* Account the transfer, bulk-out headers included, as it goes to usbnet.
+ * An skb that already has a destructor (sock_wfree, tcp_wfree) is sent
+ * through a clone of its finished data, so its destructor is left alone.
+ */
+static struct sk_buff *ax88179_tx_bql_sent(struct usbnet *dev,
+					   struct sk_buff *skb, gfp_t flags)
+{
+	struct sk_buff *orig = NULL;
+
+	BUILD_BUG_ON(sizeof(struct skb_data) + sizeof(struct ax88179_tx_cb) >
+		     sizeof_field(struct sk_buff, cb));
+
+	if (skb->destructor) {
+		orig = skb;
+		skb = skb_clone(orig, flags);
+		if (!skb) {
+			dev_kfree_skb_any(orig);
+			dev->net->stats.tx_dropped++;
+			return NULL;
+		}
 	}
 
-	/* RX bulk configuration */
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_BULKIN_QCTRL, 5, 5, tmp);
+	skb->dev = dev->net;
+	AX_TX_CB(skb)->orig = orig;
+	skb->destructor = ax88179_tx_bql_done;
 
-	if (*tmp16 & GMII_PHY_PHYSR_FULL)
-		*mode |= AX_MEDIUM_FULL_DUPLEX;	/* Bit 1 : FD */
+	netdev_sent_queue(dev->net, skb->len);
 
-	dev->rx_urb_size = (1024 * (tmp[3] + 2));
+	return skb;
+}
+#endif
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_info(dev->net, "Write medium type: 0x%04x\n", *mode);
+static struct sk_buff *
+ax88179_tx_fixup(struct usbnet *dev, struct sk_buff *skb, gfp_t flags)
+{
+#ifdef AX_TX_AGG
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	/* tx-prio frames are never aggregated and go to usbnet ahead of
+	 * whatever still waits in the driver; after that they share
+	 * usbnet's txq and the endpoint's FIFO with all other URBs
+	 */
+	if (skb && (priv->flags & AX_PRIV_FLAG_TX_PRIO) &&
+	    ax88179_tx_is_prio(skb)) {
+		priv->stats.tx_prio++;
+		if (priv->tx_agg || !skb_queue_empty(&priv->tx_agg_q))
+			priv->stats.tx_prio_bypass++;
+		skb = ax88179_tx_frame(dev, skb, flags);
+	} else if (!skb || (priv->flags & AX_PRIV_FLAGS_TX_PACK) ||
+		   priv->tx_agg || !skb_queue_empty(&priv->tx_agg_q)) {
+		skb = ax88179_tx_agg(dev, priv, skb, flags);
+	} else {
+		skb = ax88179_tx_frame(dev, skb, flags);
+	}
 #else
-		devinfo(dev, "Write medium type: 0x%04x\n", *mode);
+	skb = ax88179_tx_frame(dev, skb, flags);
 #endif
-	
-	ax88179_read_cmd(dev, 0x81, 0x8c, 0, 4, tmp32, 1);
-	delay = HZ / 2;
-	if (*tmp32 & 0x40000000) {
 
-		u16 *tmp1 = (u16*)(&tmp_16[14]);
-		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, tmp1);
+#ifdef AX_TX_BQL
+	if (skb)
+		skb = ax88179_tx_bql_sent(dev, skb, flags);
+#endif
 
-		/* Configure default medium type => giga */
-		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				  2, 2, mode);
+	return skb;
+}
 
-		jtimeout = jiffies + delay;
+/* Medium mode and bulk-in row for the PHY status in physr */
+static void ax88179_link_media(struct usbnet *dev, u16 physr)
+{
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	u16 mode = AX_MEDIUM_TXFLOW_CTRLEN | AX_MEDIUM_RXFLOW_CTRLEN;
+	int row;
 
-		while (time_before(jiffies, jtimeout)) {
-			
-			ax88179_read_cmd(dev, 0x81, 0x8c, 0, 4, tmp32, 1);
-		
-			if (!(*tmp32 & 0x40000000))
-				break;
+	if (GMII_PHY_PHYSR_GIGA == (physr & GMII_PHY_PHYSR_SMASK)) {
+		mode |= AX_MEDIUM_GIGAMODE;
+		if (dev->net->mtu > 1500)
+			mode |= AX_MEDIUM_JUMBO_EN;
+
+		if (priv->link_sts & AX_USB_SS)
+			row = 0;
+		else if (priv->link_sts & AX_USB_HS)
+			row = 1;
+		else
+			row = 3;
+	} else if (GMII_PHY_PHYSR_100 == (physr & GMII_PHY_PHYSR_SMASK)) {
+		mode |= AX_MEDIUM_PS;	/* Bit 9 : PS */
+		if (priv->link_sts & (AX_USB_SS | AX_USB_HS))
+			row = 2;
+		else
+			row = 3;
+	} else
+		row = 3;
+
+	/* RX bulk configuration */
+	ax88179_bulkin_update(dev, row);
+
+	if (physr & GMII_PHY_PHYSR_FULL)
+		mode |= AX_MEDIUM_FULL_DUPLEX;	/* Bit 1 : FD */
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+	netdev_info(dev->net, "Write medium type: 0x%04x\n", mode);
+#else
+	devinfo(dev, "Write medium type: 0x%04x\n", mode);
+#endif
+	priv->link_mode = mode;
+}
+
+/* One step of the link-up sequence, never blocks on the PHY. Returns
+ * the ms to wait before the next step, 0 when the sequence is over.
+ */
+static int ax88179_link_step(struct usbnet *dev)
+{
+	struct ax88179_data *data = (struct ax88179_data *)&dev->data;
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct ax88179_seq *seq;
+	u16 physr = 0, tmp16;
+	u32 tmp32 = 0;
+
+	switch (priv->link_state) {
+	case AX_LINK_IDLE:
+		seq = ax88179_seq_alloc(dev);
+		if (!seq)
+			return 0;
+
+		/* USB speed and the first PHY status in one round trip */
+		ax88179_seq_read(seq, AX_ACCESS_MAC, PHYSICAL_LINK_STATUS,
+				 1, 1, &priv->link_sts, 0);
+		ax88179_seq_read(seq, AX_ACCESS_PHY, AX88179_PHY_ID,
+				 GMII_PHY_PHYSR, 2, &physr, 1);
+		ax88179_seq_run(seq);
+		kfree(seq);
 
-			*tmp32 = 0x80000000;
-			ax88179_write_cmd(dev, 0x81, 0x8c, 0, 4, tmp32);
+		priv->link_deadline = jiffies + AX_LINK_PHY_TIMEOUT;
+		priv->link_state = AX_LINK_PHY;
+		break;
+	case AX_LINK_PHY:
+		ax88179_read_cmd(dev, AX_ACCESS_PHY, AX88179_PHY_ID,
+				 GMII_PHY_PHYSR, 2, &physr, 1);
+		break;
+	case AX_LINK_SETTLE:
+		ax88179_read_cmd(dev, 0x81, 0x8c, 0, 4, &tmp32, 1);
+		if ((tmp32 & 0x40000000) &&
+		    time_before(jiffies, priv->link_deadline)) {
+			tmp32 = 0x80000000;
+			ax88179_write_cmd(dev, 0x81, 0x8c, 0, 4, &tmp32);
+			return AX_LINK_SETTLE_POLL;
 		}
 
 		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_CTL,
 				  2, 2, &data->rxctl);
+		goto done;
+	default:
+		return 0;
+	}
+
+	if (!(physr & GMII_PHY_PHYSR_LINK)) {
+		if (time_before(jiffies, priv->link_deadline))
+			return AX_LINK_PHY_POLL;
+
+		/* The next link interrupt starts over */
+		priv->link_state = AX_LINK_IDLE;
+		priv->link_up = 0;
+		return 0;
+	}
+
+	ax88179_link_media(dev, physr);
+
+	ax88179_read_cmd(dev, 0x81, 0x8c, 0, 4, &tmp32, 1);
+	if (tmp32 & 0x40000000) {
+		tmp16 = 0;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &tmp16);
+
+		/* Configure default medium type => giga */
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+				  2, 2, &priv->link_mode);
+
+		priv->link_deadline = jiffies + AX_LINK_SETTLE_TIMEOUT;
+		priv->link_state = AX_LINK_SETTLE;
+		return AX_LINK_SETTLE_POLL;
 	}
 
-	*mode |= AX_MEDIUM_RECEIVE_EN;
+done:
+	priv->link_state = AX_LINK_IDLE;
+	priv->link_mode |= AX_MEDIUM_RECEIVE_EN;
 
 	/* Configure default medium type => giga */
 	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			  2, 2, mode);
+			  2, 2, &priv->link_mode);
+#ifdef AX_PHY_CACHE
+	ax88179_phy_refresh(dev);
+#endif
 	mii_check_media(&dev->mii, 1, 1);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 0, 0)	
 	if (dev->mii.force_media)
 		netif_carrier_on(dev->net);	
 #endif
-	kfree(tmp_16);
+
+	return 0;
+}
+
+#ifdef AX_LINK_WORK
+static void ax88179_link_work(struct work_struct *work)
+{
+	struct ax88179_priv *priv = container_of(work, struct ax88179_priv,
+						 link_work.work);
+	struct usbnet *dev = priv->dev;
+	int delay;
+
+	/* Link went down (or the interface closed) mid-sequence */
+	if (!priv->link_up || !netif_running(dev->net)) {
+		priv->link_state = AX_LINK_IDLE;
+		return;
+	}
+
+	delay = ax88179_link_step(dev);
+	if (delay)
+		schedule_delayed_work(&priv->link_work,
+				      msecs_to_jiffies(delay));
+}
+
+/* Stop the sequence; the next link interrupt starts it again */
+static void ax88179_link_stop(struct ax88179_priv *priv)
+{
+	cancel_delayed_work_sync(&priv->link_work);
+	priv->link_state = AX_LINK_IDLE;
+	priv->link_up = 0;
+}
+#endif
+
+static int ax88179_link_reset(struct usbnet *dev)
+{
+#ifdef AX_LINK_WORK
+	/* Only reached through usbnet_link_change(); hand it to link_work */
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+
+	if (netif_running(dev->net) && !priv->link_up) {
+		priv->link_up = 1;
+		mod_delayed_work(system_wq, &priv->link_work, 0);
+	}
+#else
+	int delay;
+
+	while ((delay = ax88179_link_step(dev)) > 0)
+		msleep(delay);
+#endif
 
 	return 0;
 }
 
 static int ax88179_reset(struct usbnet *dev)
 {
-	void *buf = NULL;
+	struct ax88179_priv *priv = ax88179_get_priv(dev);
+	struct ax88179_seq *seq;
+	u16 buf[3];
 	u16 *tmp16 = NULL;
 	u8 *tmp = NULL;
 	struct ax88179_data *ax179_data = (struct ax88179_data *) dev->data;
-	buf = kmalloc(6, GFP_KERNEL);
-
-	if (!buf) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-		netdev_err(dev->net, "Cannot allocate memory for buffer");
-#else
-		deverr(dev, "Cannot allocate memory for buffer");
-#endif
-		return -ENOMEM;
-	}
+	ktime_t start, t;
+	bool fast;
 
+	start = t = ktime_get();
 	tmp16 = (u16 *)buf;
 	tmp = (u8 *)buf;
 
-	/* Power up ethernet PHY */
-	*tmp16 = 0;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, tmp16);
-	*tmp16 = AX_PHYPWR_RSTCTL_IPRL;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL, 2, 2, tmp16);
-	msleep(200);
+	/* Right after bind only the settings bind does not make are left */
+	fast = fast_start && priv->hw_ready;
+	priv->hw_ready = 0;
 
-	*tmp = AX_CLK_SELECT_ACS | AX_CLK_SELECT_BCS;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_CLK_SELECT, 1, 1, tmp);
-	msleep(100);
+#ifdef AX_PHY_CACHE
+	ax88179_phy_stop(priv);
+#endif
+
+	if (!fast) {
+		/* Power up ethernet PHY */
+		*tmp16 = 0;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
+				  2, 2, tmp16);
+		*tmp16 = AX_PHYPWR_RSTCTL_IPRL;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PHYPWR_RSTCTL,
+				  2, 2, tmp16);
+		msleep(200);
+		ax88179_step_time(dev, "PHY power-up", &t);
+
+		*tmp = AX_CLK_SELECT_ACS | AX_CLK_SELECT_BCS;
+		ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_CLK_SELECT,
+				  1, 1, tmp);
+		msleep(100);
+		ax88179_step_time(dev, "clock select", &t);
+	}
 
 	/* Ethernet PHY Auto Detach*/
 	ax88179_AutoDetach(dev, 0);
 
+	/* RX bulk configuration */
+	ax88179_bulkin_update(dev, 0);
+
+	/* The rest of the setup needs no delays, queue it */
+	seq = ax88179_seq_alloc(dev);
+	if (!seq)
+		return -ENOMEM;
+
 	/* Set the MAC address */
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_NODE_ID, ETH_ALEN,
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_NODE_ID, ETH_ALEN,
 			  ETH_ALEN, dev->net->dev_addr);
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
@@ -2115,17 +5438,11 @@ static int ax88179_reset(struct usbnet *dev)
 	dev->net->dev_addr[4], dev->net->dev_addr[5]);
 #endif
 
-	/* RX bulk configuration */
-	memcpy(tmp, &AX88179_BULKIN_SIZE[0], 5);
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_BULKIN_QCTRL, 5, 5, tmp);
-
-	dev->rx_urb_size = 1024 * 20;
-
 	tmp[0] = 0x34;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW, 1, 1, tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW, 1, 1, tmp);
 
 	tmp[0] = 0x52;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
 			  1, 1, tmp);
 
 	dev->net->features |= NETIF_F_IP_CSUM;
@@ -2135,23 +5452,23 @@ static int ax88179_reset(struct usbnet *dev)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
 	if (usb_device_no_sg_constraint(dev->udev))
 		dev->can_dma_sg = 1;
-	dev->net->features |= NETIF_F_SG | NETIF_F_TSO;
+	dev->net->features |= NETIF_F_SG | NETIF_F_TSO | NETIF_F_TSO6;
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 39)
 	dev->net->hw_features |= NETIF_F_IP_CSUM;
 	dev->net->hw_features |= NETIF_F_IPV6_CSUM;
-	dev->net->hw_features |= NETIF_F_SG | NETIF_F_TSO;
+	dev->net->hw_features |= NETIF_F_SG | NETIF_F_TSO | NETIF_F_TSO6;
 #endif
 
 	/* Enable checksum offload */
 	*tmp = AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
 	       AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, tmp);
 
 	*tmp = AX_TXCOE_IP | AX_TXCOE_TCP | AX_TXCOE_UDP |
 	       AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, tmp);
 
 	ax179_data->checksum |= AX_RX_CHECKSUM | AX_TX_CHECKSUM;
 
@@ -2160,38 +5477,50 @@ static int ax88179_reset(struct usbnet *dev)
 		 AX_RX_CTL_AMALL | AX_RX_CTL_AB;
 	if (NET_IP_ALIGN == 0)
 		*tmp16 |= AX_RX_CTL_IPE;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, tmp16);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, tmp16);
 
 	*tmp = AX_MONITOR_MODE_PMETYPE | AX_MONITOR_MODE_PMEPOL |
 						AX_MONITOR_MODE_RWMP;
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, tmp);
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, tmp);
 
-	ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, tmp, 0);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
-	netdev_dbg(dev->net, "Monitor mode = 0x%02x\n", *tmp);
-#else
-	devdbg(dev, "Monitor mode = 0x%02x\n", *tmp);
-#endif
+	ax88179_seq_read(seq, AX_ACCESS_MAC, AX_MONITOR_MODE, 1, 1, tmp, 0);
 
 	/* Configure default medium type => giga */
 	*tmp16 = AX_MEDIUM_TXFLOW_CTRLEN | AX_MEDIUM_RXFLOW_CTRLEN |
 		 AX_MEDIUM_FULL_DUPLEX | AX_MEDIUM_GIGAMODE;
 
-	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+	ax88179_seq_write(seq, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
 			  2, 2, tmp16);
 
-	ax88179_led_setting(dev);
+	ax88179_seq_run(seq);
+	kfree(seq);
+	ax88179_step_time(dev, "MAC setup", &t);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
+	netdev_dbg(dev->net, "Monitor mode = 0x%02x\n", *tmp);
+#else
+	devdbg(dev, "Monitor mode = 0x%02x\n", *tmp);
+#endif
 
-	ax88179_EEE_setting(dev);
+	if (!fast) {
+		ax88179_led_setting(dev);
+		ax88179_step_time(dev, "LED setup", &t);
 
-	ax88179_Gether_setting(dev);
+		ax88179_EEE_setting(dev);
 
-	/* Restart autoneg */
-	mii_nway_restart(&dev->mii);
+		ax88179_Gether_setting(dev);
+
+		/* Restart autoneg */
+		mii_nway_restart(&dev->mii);
+		ax88179_step_time(dev, "PHY setup", &t);
+	}
 
 	netif_carrier_off(dev->net);
+#ifdef AX_PHY_CACHE
+	ax88179_phy_start(priv);
+#endif
+	ax88179_step_time(dev, fast ? "reset total, fast start" :
+			  "reset total", &start);
 
-	kfree(buf);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 	netdev_dbg(dev->net, "mtu %d\n", dev->net->mtu);
 #else
@@ -2205,18 +5534,23 @@ static int ax88179_reset(struct usbnet *dev)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 static int ax88179_stop(struct usbnet *dev)
 {
-	u16 *tmp16;
-	tmp16 = kmalloc(2, GFP_KERNEL);
-	if (!tmp16)
-		return -ENOMEM;
+	u16 tmp16;
 
+#ifdef AX_RX_DIM
+	cancel_work_sync(&ax88179_get_priv(dev)->rx_dim.work);
+#endif
+#ifdef AX_LINK_WORK
+	ax88179_link_stop(ax88179_get_priv(dev));
+#endif
+#ifdef AX_PHY_CACHE
+	ax88179_phy_stop(ax88179_get_priv(dev));
+#endif
 	ax88179_read_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			 2, 2, tmp16, 1);
-	*tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
+			 2, 2, &tmp16, 1);
+	tmp16 &= ~AX_MEDIUM_RECEIVE_EN;
 	ax88179_write_cmd(dev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			  2, 2, tmp16);
+			  2, 2, &tmp16);
 
-	kfree(tmp16);
 	return 0;
 }
 #endif
@@ -2231,7 +5565,8 @@ static const struct driver_info ax88179_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2250,7 +5585,8 @@ static const struct driver_info ax88178a_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2267,7 +5603,8 @@ static const struct driver_info sitecom_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2284,7 +5621,8 @@ static const struct driver_info lenovo_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2301,7 +5639,8 @@ static const struct driver_info toshiba_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2318,7 +5657,8 @@ static const struct driver_info samsung_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2335,7 +5675,8 @@ static const struct driver_info dlink_info = {
 	.reset	= ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop	= ax88179_stop,
-	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags	= FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags	= FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2352,7 +5693,8 @@ static const struct driver_info mct_info = {
 	.reset  = ax88179_reset,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 32)
 	.stop   = ax88179_stop,
-	.flags  = FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS,
+	.flags  = FLAG_ETHER | FLAG_FRAMING_AX | FLAG_AVOID_UNLINK_URBS |
+		  AX_FLAG_MULTI_PACKET,
 #else
 	.flags  = FLAG_ETHER | FLAG_FRAMING_AX,
 #endif
@@ -2405,6 +5747,14 @@ static struct usb_driver asix_driver = {
 	.suspend =	ax88179_suspend,
 	.resume =	ax88179_resume,
 	.disconnect =	usbnet_disconnect,
+	/* bind keeps all of its state in the device, adapters may probe
+	 * in parallel
+	 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 2, 0)
+	.drvwrap.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
 };
 
 
@@ -2,6 +2,94 @@
 #define	__LINUX_USBNET_ASIX_H
 
 //#define RX_SKB_COPY
+
+/* RX frames up to the copybreak are copied out of the bulk-in buffer;
+ * RX_SKB_COPY makes copying every frame the default.
+ */
+#define AX_RX_COPYBREAK_MAX		0x1fff	/* rx header length field */
+#ifdef RX_SKB_COPY
+#define AX_RX_COPYBREAK_DEFAULT		AX_RX_COPYBREAK_MAX
+#else
+#define AX_RX_COPYBREAK_DEFAULT		256
+#endif
+
+/* NAPI/GRO receive path (ethtool private flag "rx-napi") */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+#define AX_NAPI_RX
+#endif
+
+/* NAPI ring pages come from a DMA-mapped page_pool */
+#if defined(AX_NAPI_RX) && LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#define AX_RX_PAGE_POOL
+#endif
+
+/* XDP on the NAPI bulk-in ring */
+#if defined(AX_NAPI_RX) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+#define AX_XDP
+#endif
+
+/* Bulk-out aggregation (ethtool private flag "tx-aggregation"), relies on
+ * FLAG_MULTI_PACKET to return no URB for queued frames.
+ */
+#ifdef AX_NAPI_RX
+#define AX_TX_AGG
+#endif
+
+/* Flow hash for RPS/RFS (NETIF_F_RXHASH) */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#define AX_RX_HASH
+#endif
+
+/* Preallocated bulk-out buffers for frames that cannot go out as SG */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0)
+#define AX_TX_BOUNCE
+#endif
+
+/* Byte queue limits on bulk-out skbs, reset by ndo_open/ndo_stop */
+#ifdef AX_NAPI_RX
+#define AX_TX_BQL
+#endif
+
+/* Driver-mode AF_XDP on the NAPI bulk-in ring. From 6.3 the core only
+ * binds it for NETDEV_XDP_ACT_XSK_ZEROCOPY, which a driver that copies
+ * every frame does not claim; sockets then run in copy mode.
+ */
+#if defined(AX_XDP) && LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+#define AX_XSK
+#endif
+
+/* Adaptive RX aggregation (ethtool -C adaptive-rx) */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0)
+#define AX_RX_DIM
+#endif
+
+/* Vendor command sequences submitted as queued control URBs */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0)
+#define AX_CMD_SEQ
+#endif
+
+/* Link-up sequence on a per-device delayed work kicked by the status
+ * interrupt (mod_delayed_work), instead of usbnet's EVENT_LINK_RESET.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 7, 0)
+#define AX_LINK_WORK
+#endif
+
+/* PHY status served from a cache refreshed on link events and by a
+ * slow timer while the interface is up.
+ */
+#ifdef AX_LINK_WORK
+#define AX_PHY_CACHE
+#endif
+
+/* The driver hands every received frame to the stack itself, so usbnet
+ * must not deliver the bulk-in skb (nor pad short bulk-out transfers).
+ */
+#ifdef AX_NAPI_RX
+#define AX_FLAG_MULTI_PACKET		FLAG_MULTI_PACKET
+#else
+#define AX_FLAG_MULTI_PACKET		0
+#endif
 #define DRIVER_VERSION		"1.20.0"
 #define DRIVER_DESCRIPTION	"ASIX AX88179_178A USB 2.0/3.0 Ethernet Devices"
 #define DRIVER_AUTHOR		"David Hollis"
@@ -19,6 +107,24 @@
 #define AX_TX_CHECKSUM			2
 
 #define AX_BULKIN_24K			0x18;	/* 24k */
+#define AX_BULKIN_SIZE_MAX		24	/* KB */
+#define AX_BULKIN_TIMER_MAX		0xffff
+/* Bulk In Queue timer tick: the 100 Mbps row of AX88179_BULKIN_SIZE[]
+ * waits 1966 ticks, the time 24KB take at that speed.
+ */
+#define AX_BULKIN_TIMER_NS		1000
+#define AX_BULKIN_IFG_MAX		0xff
+/* MAC configuration registers mirrored in ax88179_priv, one bit per byte:
+ * MEDIUM_STATUS_MODE, PHYPWR_RSTCTL and RX_BULKIN_QCTRL..TXCOE_CTL.
+ */
+#define AX_REG_SHADOW_SIZE		0x40
+#define AX_REG_BITS(reg, size)		((((u64)1 << (size)) - 1) << (reg))
+#define AX_REG_SHADOW_MASK		(AX_REG_BITS(0x22, 2) | \
+					 AX_REG_BITS(0x26, 2) | \
+					 AX_REG_BITS(0x2e, 8))
+
+/* Per frame: IP alignment pseudo header, 8-byte alignment, packet header */
+#define AX_RX_FRAME_OVERHEAD		16
 
 #define AX_ACCESS_MAC			0x01
 #define AX_ACCESS_PHY			0x02
@@ -292,17 +398,351 @@
 
 /******************************************************************************/
 
+struct ax88179_priv;
+
 struct ax88179_data {
 	u16 rxctl;
 	u8  checksum;
 	unsigned char reg_monitor;
+	struct ax88179_priv *priv;
 } __attribute__ ((packed));
 
+/* ethtool private flags */
+#define AX_PRIV_FLAG_RX_NAPI		(1 << 0)
+#define AX_PRIV_FLAG_TX_AGG		(1 << 1)
+#define AX_PRIV_FLAG_TX_XMIT_MORE	(1 << 2)
+#define AX_PRIV_FLAG_TX_PRIO		(1 << 3)
+/* Either one holds frames back in the driver */
+#define AX_PRIV_FLAGS_TX_PACK		(AX_PRIV_FLAG_TX_AGG | \
+					 AX_PRIV_FLAG_TX_XMIT_MORE)
+
+/* Redirected frames are copied into an order-0 page */
+#define AX_XDP_MAX_LEN		(PAGE_SIZE - XDP_PACKET_HEADROOM - \
+				 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+#define AX_XDP_MAX_MTU		(AX_XDP_MAX_LEN - ETH_HLEN - VLAN_HLEN)
+/* Frames across two ring pages are copied here for the program */
+#define AX_XDP_RX_BUF_SIZE	(AX_RX_COPYBREAK_MAX + 1)
+
+/* Driver-owned bulk-in ring used by the NAPI receive path.  Hosts with SG
+ * fill each buffer through urb->sg as AX_RX_BUF_PAGES order-0 pages, so a
+ * frame only pins the pages it spans; others get one AX_RX_BUF_SIZE page.
+ */
+#define AX_RX_RING_SIZE			8
+#define AX_RX_BUF_SIZE			(32 * 1024)
+#define AX_RX_BUF_PAGES			DIV_ROUND_UP(AX_RX_BUF_SIZE, PAGE_SIZE)
+#define AX_RX_HDR_LEN			128	/* max bytes copied to skb head */
+#define AX_RX_REFILL_DELAY		(HZ / 20)
+#define AX_RX_PP_BIAS			1024	/* > frames per buffer */
+
+/* Bulk-out transfers carrying several frames, each behind its own 8 byte
+ * header starting on an AX_TX_ALIGN boundary.
+ */
+#define AX_TX_HDR_LEN			8
+#define AX_TX_ALIGN			4
+#define AX_TSO_MAX_SIZE			16384	/* IPv4 and IPv6 TSO */
+/* Segments of a 16KB super-frame at TCP's smallest MSS (TCP_MIN_SND_MSS) */
+#define AX_TSO_MAX_SEGS			DIV_ROUND_UP(AX_TSO_MAX_SIZE, 48)
+/* TCP fills gso_max_size less MAX_TCP_HEADER + 1 with whole segments, which
+ * at a jumbo MSS leaves a whole segment of the 16KB unused. Hand the reserve
+ * back less the largest Ethernet, VLAN, IPv6 and TCP headers; other GSO
+ * frames over 16KB are segmented by ax88179_features_check().
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 0, 0)
+#define AX_TSO_HDR_MAX	(ETH_HLEN + VLAN_HLEN + sizeof(struct ipv6hdr) + \
+			 sizeof(struct tcphdr) + MAX_TCP_OPTION_SPACE)
+#define AX_GSO_MAX_SIZE	(AX_TSO_MAX_SIZE - AX_TSO_HDR_MAX + MAX_TCP_HEADER + 1)
+#else
+#define AX_GSO_MAX_SIZE	AX_TSO_MAX_SIZE
+#endif
+
+/* Bounce ring: each slot is a compound page holding the header, the
+ * largest frame, the padding byte and the skb_shared_info of build_skb()
+ */
+#define AX_TX_BOUNCE_SLOTS		4
+#define AX_TX_BOUNCE_LEN		(AX_TX_HDR_LEN + AX_TSO_MAX_SIZE + 1)
+#define AX_TX_BOUNCE_ORDER \
+	get_order(SKB_DATA_ALIGN(AX_TX_BOUNCE_LEN) + \
+		  SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+/* tx-prio: frames from this skb->priority, or with an IP precedence of
+ * 5 and up in the DS field, skip the frames waiting in the driver. As
+ * DSCP that is CS5 (40) and everything above, EF (46) included.
+ */
+#define AX_TX_PRIO_MIN			TC_PRIO_INTERACTIVE
+#define AX_TX_PRIO_PREC_MIN		IPTOS_PREC_CRITIC_ECP
+
+/* tx-aggregation: frames are copied into one bulk-out skb until it is
+ * full, the timer expires or, with tx-xmit-more, the burst ends.
+ */
+#define AX_TX_AGG_SIZE			(16 * 1024)
+#define AX_TX_AGG_TIMEOUT		(100 * NSEC_PER_USEC)
+
+/* XDP_TX and AF_XDP transmit: frames packed into driver-owned URBs */
+#define AX_XDP_TX_URBS			4
+#define AX_XDP_TX_BUF_SIZE		(16 * 1024)
+
+enum ax88179_rx_buf_state {
+	AX_RX_BUF_IDLE = 0,	/* not submitted, waits for the refill work */
+	AX_RX_BUF_SUBMITTED,
+	AX_RX_BUF_DONE,		/* completed, waits for the NAPI poll */
+};
+
+struct ax88179_rx_buf {
+	struct ax88179_priv	*priv;
+	struct urb		*urb;
+	struct page		*page[AX_RX_BUF_PAGES];	/* rx_seg_shift */
+#ifdef AX_RX_PAGE_POOL
+	long			pp_bias[AX_RX_BUF_PAGES]; /* refs still ours */
+#endif
+	struct scatterlist	sg[AX_RX_BUF_PAGES];
+	struct list_head	list;
+	u8			state;
+};
+
+/* Kept behind usbnet's struct skb_data in skb->cb of bulk-out skbs */
+struct ax88179_tx_cb {
+	struct sk_buff	*orig;		/* sent through this clone */
+};
+
+#define AX_TX_CB(skb)	((struct ax88179_tx_cb *) \
+			 ((skb)->cb + sizeof(struct skb_data)))
+
+struct ax88179_xdp_tx {
+	struct ax88179_priv	*priv;
+	struct urb		*urb;
+	u8			*buf;		/* AX_XDP_TX_BUF_SIZE */
+	u32			len;		/* bytes in buf */
+	u32			last;		/* last frame's header */
+	u32			frames;		/* frames in this URB */
+	u32			bytes;
+	u32			descs;		/* AF_XDP TX descriptors */
+	u32			seq;		/* AF_XDP completion order */
+	u8			busy;
+};
+
+/* One bulk-in transfer: a linear buffer, or the pages of a ring buffer
+ * that are 1 << shift bytes each
+ */
+struct ax88179_rx_src {
+	const u8	*data;
+	struct page	**pages;
+	u8		shift;
+};
+
+/* Cursor over one aggregated bulk-in transfer, kept in skb->cb */
+struct ax88179_rx_agg {
+	u32	len;		/* frame area, trailer excluded */
+	u32	pkt_off;	/* next frame */
+	u16	hdr_off;	/* next per-packet header */
+	u16	pkt_cnt;	/* frames left */
+	u8	parsed;
+};
+
+/* ethtool -S counters, in ax88179_stats_strings order */
+struct ax88179_stats {
+	u64	rx_pool_hit;		/* ring page reused in place */
+	u64	rx_pool_miss;		/* ring page allocated */
+	u64	rx_xdp_drop;
+	u64	rx_xdp_tx;
+	u64	rx_xdp_redirect;
+	u64	rx_xdp_aborted;		/* incl. failed XDP_TX/REDIRECT */
+	u64	rx_xsk_nobuf;		/* AF_XDP fill ring empty */
+	u64	tx_xsk_frames;
+	u64	tx_agg_urbs;		/* aggregated bulk-out transfers */
+	u64	tx_agg_frames;		/* frames in them */
+	u64	tx_agg_timeout;		/* transfers flushed by the timer */
+	u64	tx_xmit_more;		/* frames held for the rest of a burst */
+	u64	tx_burst_end;		/* bursts whose transfers were released */
+	u64	tx_sg;			/* fragments mapped, nothing copied */
+	u64	tx_bounce;		/* copied once into the bounce ring */
+	u64	tx_pull;		/* linearized, bounce ring busy */
+	u64	tx_head_copy;		/* head reallocated for the header */
+	u64	tx_prio;		/* classified by tx-prio */
+	u64	tx_prio_bypass;		/* ... ahead of frames waiting */
+};
+
+/* Largest vendor request that goes through ax88179_priv.io_buf */
+#define AX_IO_BUF_LEN			64
+
+/* Preallocated async control writes, one slot per register */
+#define AX_ASYNC_SLOTS			4
+#define AX_ASYNC_DATA_LEN		8
+
 struct ax88179_async_handle {
-  	struct usb_ctrlrequest *req;
-  	u8 m_filter[8];
-  	u16 rxctl;
-} __attribute__ ((packed));
+	struct ax88179_priv	*priv;
+	struct urb		*urb;
+	struct usb_ctrlrequest	req;
+	u16			size;
+	u8			used;		/* req names the register */
+	u8			busy;		/* urb in flight */
+	u8			dirty;		/* next to be sent after it */
+	u8			known;		/* data is in the register */
+	u8			next[AX_ASYNC_DATA_LEN];
+	u8			data[AX_ASYNC_DATA_LEN] ____cacheline_aligned;
+};
+
+/* Link-up sequence, see ax88179_link_step() */
+enum {
+	AX_LINK_IDLE = 0,
+	AX_LINK_PHY,		/* waiting for GMII_PHY_PHYSR_LINK */
+	AX_LINK_SETTLE,		/* waiting for 0x8c bit 30 to clear */
+};
+
+#define AX_LINK_PHY_TIMEOUT		(10 * HZ)
+#define AX_LINK_PHY_POLL		10	/* ms */
+#define AX_LINK_SETTLE_TIMEOUT		(HZ / 2)
+#define AX_LINK_SETTLE_POLL		2	/* ms */
+
+/* PHY registers kept in ax88179_priv.phy_cache, see ax88179_phy_regs[] */
+enum {
+	AX_PHY_BMCR = 0,
+	AX_PHY_BMSR,
+	AX_PHY_ADVERTISE,
+	AX_PHY_LPA,
+	AX_PHY_CTRL1000,
+	AX_PHY_STAT1000,
+	AX_PHY_PHYSR,
+	AX_PHY_CACHED
+};
+
+/* Registers the PHY changes by itself */
+#define AX_PHY_STATUS_MASK		(BIT(AX_PHY_BMSR) | BIT(AX_PHY_LPA) | \
+					 BIT(AX_PHY_STAT1000) | \
+					 BIT(AX_PHY_PHYSR))
+/* Link interrupts refresh the cache; the timer only catches the rest */
+#define AX_PHY_REFRESH			(30 * HZ)
+
+/* Per-device state that does not fit into usbnet's dev->data */
+struct ax88179_priv {
+	struct usbnet		*dev;
+	u32			flags;		/* AX_PRIV_FLAG_* */
+	u8			hw_ready;	/* PHY set up by bind, not yet opened */
+
+	/* Register shadow, bytes as on the wire */
+	spinlock_t		reg_lock;
+	u64			reg_valid;	/* AX_REG_BITS() of reg_shadow */
+	u8			reg_shadow[AX_REG_SHADOW_SIZE];
+
+	/* Synchronous vendor requests */
+	struct mutex		io_lock;
+	u8			*io_buf;	/* AX_IO_BUF_LEN, DMA-safe */
+
+	/* RX mode updates from atomic context */
+	spinlock_t		async_lock;
+	struct ax88179_async_handle async[AX_ASYNC_SLOTS];
+
+	/* Link-up sequence */
+	u8			link_up;	/* last link bit reported */
+	u8			link_state;	/* AX_LINK_* */
+	u8			link_sts;	/* PHYSICAL_LINK_STATUS */
+	u16			link_mode;	/* medium mode being set up */
+	unsigned long		link_deadline;	/* jiffies */
+#ifdef AX_LINK_WORK
+	struct delayed_work	link_work;
+#endif
+#ifdef AX_PHY_CACHE
+	/* PHY registers, under reg_lock */
+	u8			phy_on;		/* refreshed by phy_work */
+	u8			phy_valid;	/* BIT(AX_PHY_*) */
+	u16			phy_cache[AX_PHY_CACHED];
+	struct delayed_work	phy_work;
+#endif
+
+	u32			rx_copybreak;
+#ifdef AX_RX_HASH
+	u32			rx_hash_seed;
+#endif
+
+	/* RX aggregation (AX_RX_BULKIN_QCTRL), -1 = link speed default;
+	 * everything from here to rx_dim_profile under bulkin_lock
+	 */
+	struct mutex		bulkin_lock;
+	int			rx_coal_usecs;	/* timer, us */
+	int			rx_coal_size;	/* KB */
+	int			rx_coal_ifg;	/* 0.25us */
+	u8			bulkin_row;	/* AX88179_BULKIN_SIZE[] for link */
+	u8			bulkin[5];	/* as written to the device */
+	u8			rx_dim_on;	/* adaptive-rx */
+	u8			rx_dim_profile;	/* ax88179_dim_profiles[] */
+#ifdef AX_RX_DIM
+	struct dim		rx_dim;
+	u16			rx_dim_events;	/* bulk-in transfers */
+	u64			rx_dim_pkts;
+	u64			rx_dim_bytes;
+#endif
+#ifdef AX_NAPI_RX
+	struct napi_struct	napi;
+	struct sk_buff_head	rx_napi_q;	/* bulk-in transfers to de-aggregate */
+
+	struct ax88179_rx_buf	rx_ring[AX_RX_RING_SIZE];
+	struct list_head	rx_done;	/* AX_RX_BUF_DONE, oldest first */
+	spinlock_t		rx_lock;
+	struct ax88179_rx_buf	*rx_cur;	/* partly delivered by the poll */
+	struct ax88179_rx_agg	rx_agg;		/* cursor into rx_cur */
+	struct delayed_work	rx_refill;
+	u8			rx_ring_on;
+	u8			rx_seg_shift;	/* ring page size, log2 */
+	u8			rx_segs;	/* ring pages per buffer */
+#endif
+#ifdef AX_XDP
+	struct bpf_prog		*xdp_prog;
+	struct xdp_rxq_info	xdp_rxq;	/* registered while open */
+	u8			xdp_flush;	/* redirects since last flush */
+	u8			*xdp_rx_buf;	/* frames across ring pages */
+	struct ax88179_xdp_tx	xdp_tx[AX_XDP_TX_URBS];
+	struct ax88179_xdp_tx	*xdp_tx_cur;	/* XDP_TX, sent after the poll */
+	struct usb_anchor	xdp_tx_anchor;	/* submitted xdp_tx URBs */
+#endif
+#ifdef AX_TX_AGG
+	struct sk_buff		*tx_agg;	/* being filled */
+	u32			tx_agg_last;	/* last frame's header */
+	u32			tx_agg_frames;
+	u32			tx_agg_bytes;	/* frames without headers */
+	struct sk_buff_head	tx_agg_q;	/* ready, sent before new frames */
+	u8			tx_burst;	/* tx_agg_q held for xmit_more */
+	struct hrtimer		tx_agg_timer;
+	struct tasklet_struct	tx_agg_bh;	/* drains tx_agg_q */
+#endif
+#ifdef AX_TX_BOUNCE
+	struct page		*tx_bounce[AX_TX_BOUNCE_SLOTS];	/* idle: one ref */
+	u8			tx_bounce_next;
+#endif
+#ifdef AX_XSK
+	struct xsk_buff_pool	*xsk_pool;	/* queue 0, NULL: no socket */
+	struct xdp_rxq_info	xsk_rxq;	/* UMEM frames, registered while open */
+	u32			xsk_tx_seq;	/* next xdp_tx with descriptors */
+	u32			xsk_tx_done;	/* next one to complete */
+#endif
+#ifdef AX_RX_PAGE_POOL
+	struct page_pool	*rx_pool;	/* NULL: plain pages, usb maps */
+	struct device		*dma_dev;
+#endif
+	struct ax88179_stats	stats;
+};
+
+/* Vendor command sequence, see ax88179_seq_run() */
+#define AX_SEQ_MAX			16
+#define AX_SEQ_DATA_LEN			8
+
+struct ax88179_seq_cmd {
+	struct usb_ctrlrequest	req;
+	struct urb		*urb;
+	void			*dest;		/* read result */
+	int			eflag;		/* dest in CPU byte order */
+	u8			data[AX_SEQ_DATA_LEN] ____cacheline_aligned;
+};
+
+struct ax88179_seq {
+	struct usbnet		*dev;
+	int			count;
+	int			status;		/* first error */
+#ifdef AX_CMD_SEQ
+	struct usb_anchor	anchor;
+	struct completion	done;
+	atomic_t		pending;
+	struct ax88179_seq_cmd	cmd[AX_SEQ_MAX];
+#endif
+};
 
 struct ax88179_int_data {
 	__le16 res1;
@@ -334,28 +774,20 @@ struct ax88179_int_data {
 #define AX_RXHDR_CRC_ERR			0x20000000
 #define AX_RXHDR_MII_ERR			0x40000000
 #define AX_RXHDR_DROP_ERR			0x80000000
-#if 0
-struct ax88179_rx_pkt_header {
-
-	u8	l4_csum_err:1,
-		l3_csum_err:1,
-		l4_type:3,
-		l3_type:2,
-		ce:1;
 
-	u8	vlan_ind:3,
-		rx_ok:1,
-		pri:3,
-		bmc:1;
-
-	u16	len:13,
-		crc:1,
-		mii:1,
-		drop:1;
-
-} __attribute__ ((packed));
-#endif
-static struct {unsigned char ctrl, timer_l, timer_h, size, ifg; }
+/* Per-packet RX header, little endian, from bit 0:
+ * l4_csum_err:1 l3_csum_err:1 l4_type:3 l3_type:2 ce:1
+ * vlan_ind:3 rx_ok:1 pri:3 bmc:1 len:13 crc:1 mii:1 drop:1
+ */
+#define AX_RXHDR_L3_TYPE_MASK			0x60
+#define AX_RXHDR_L3_TYPE_SHIFT			5
+#define AX_RXHDR_CE				0x80
+#define AX_RXHDR_VLAN_IND_MASK			0x0700
+#define AX_RXHDR_RX_OK				0x0800
+#define AX_RXHDR_PRI_MASK			0x7000
+#define AX_RXHDR_PRI_SHIFT			12
+#define AX_RXHDR_BMC				0x8000
+static const struct {unsigned char ctrl, timer_l, timer_h, size, ifg; }
 AX88179_BULKIN_SIZE[] =	{
 	{7, 0x4f, 0,	0x12, 0xff},
 	{7, 0x20, 3,	0x16, 0xff},
@@ -366,6 +798,43 @@ AX88179_BULKIN_SIZE[] =	{
 static int ax88179_reset(struct usbnet *dev);
 static int ax88179_link_reset(struct usbnet *dev);
 static int ax88179_AutoDetach(struct usbnet *dev, int in_pm);
+static void ax88179_async_forget(struct ax88179_priv *priv, u16 reg);
+#ifdef AX_LINK_WORK
+static void ax88179_link_work(struct work_struct *work);
+static void ax88179_link_stop(struct ax88179_priv *priv);
+#endif
+#ifdef AX_PHY_CACHE
+static void ax88179_phy_work(struct work_struct *work);
+#endif
+#ifdef AX_RX_DIM
+static void ax88179_dim_work(struct work_struct *work);
+#endif
+#ifdef AX_NAPI_RX
+static int ax88179_napi_poll(struct napi_struct *napi, int budget);
+static void ax88179_rx_refill_work(struct work_struct *work);
+static void ax88179_rx_ring_start(struct ax88179_priv *priv);
+static void ax88179_rx_ring_stop(struct ax88179_priv *priv);
+static void ax88179_rx_ring_flush(struct ax88179_priv *priv);
+static void ax88179_rx_page_free(struct ax88179_priv *priv,
+				 struct ax88179_rx_buf *buf);
+static void ax88179_rx_ring_init(struct ax88179_priv *priv);
+static void ax88179_rx_pool_create(struct ax88179_priv *priv);
+static void ax88179_rx_pool_destroy(struct ax88179_priv *priv);
+#endif
+#ifdef AX_TX_AGG
+static enum hrtimer_restart ax88179_tx_agg_timer(struct hrtimer *timer);
+static void ax88179_tx_agg_bh(struct tasklet_struct *t);
+static void ax88179_tx_agg_close(struct usbnet *dev,
+				 struct ax88179_priv *priv);
+static void ax88179_tx_agg_stop(struct ax88179_priv *priv);
+#endif
+#ifdef AX_XDP
+static void ax88179_xdp_tx_stop(struct ax88179_priv *priv);
+#endif
+#ifdef AX_XSK
+static void ax88179_xsk_tx_poll(struct ax88179_priv *priv);
+static void ax88179_xsk_tx_complete(struct ax88179_priv *priv);
+#endif
 
 #endif /* __LINUX_USBNET_ASIX_H */
 